@@ -0,0 +1,166 @@
+#include "bench.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t cycles() {
+    _mm_lfence();
+    uint64_t c = __rdtsc();
+    _mm_lfence();
+    return c;
+}
+#else
+static inline uint64_t cycles() {
+    return 0;
+}
+#endif
+
+static volatile uint64_t sink;
+
+void Bench_consume(uint64_t v) {
+    sink += v;
+}
+
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*) a, y = *(const double*) b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile(const double sorted[], int n, double q) {
+    double pos = q * (n - 1);
+    int i = pos;
+    if (i + 1 >= n) return sorted[n - 1];
+    return sorted[i] + (pos - i) * (sorted[i + 1] - sorted[i]);
+}
+
+static bool matches(const Bench* bench, const BenchOptions* opts) {
+    return opts->filter == NULL || strstr(bench->name, opts->filter) != NULL;
+}
+
+void Bench_run(const Bench* bench, const BenchOptions* opts) {
+    if (!matches(bench, opts)) return;
+
+    // find the iterations that make one sample long enough to time
+    uint64_t iters = 1;
+    while (1) {
+        double begin = now_ns();
+        bench->fn(bench->arg, iters);
+        double ns = now_ns() - begin;
+        if (ns >= opts->minSampleNs || iters >= (1ull << 40)) break;
+        iters = ns <= 0 ? iters * 16 : iters * (opts->minSampleNs / ns * 1.2 + 1);
+    }
+
+    for (int i = 0; i < opts->warmup; i++) {
+        bench->fn(bench->arg, iters);
+    }
+
+    double* ns = malloc(sizeof(double) * opts->samples);
+    double* cyc = malloc(sizeof(double) * opts->samples);
+    for (int i = 0; i < opts->samples; i++) {
+        double begin = now_ns();
+        uint64_t c0 = cycles();
+        bench->fn(bench->arg, iters);
+        uint64_t c1 = cycles();
+        ns[i] = (now_ns() - begin) / iters;
+        cyc[i] = (double) (c1 - c0) / iters;
+    }
+
+    double mean = 0;
+    for (int i = 0; i < opts->samples; i++) {
+        mean += ns[i];
+    }
+    mean /= opts->samples;
+    double var = 0;
+    for (int i = 0; i < opts->samples; i++) {
+        var += (ns[i] - mean) * (ns[i] - mean);
+    }
+    double stddev = opts->samples > 1 ? sqrt(var / (opts->samples - 1)) : 0;
+    qsort(ns, opts->samples, sizeof(double), cmp_double);
+    qsort(cyc, opts->samples, sizeof(double), cmp_double);
+    double median = percentile(ns, opts->samples, 0.5);
+
+    fprintf(opts->out,
+            "{\"name\":\"%s\",\"iters\":%llu,\"samples\":%d,\"ns_min\":%.2f,\"ns_median\":%.2f,\"ns_mean\":%.2f,"
+            "\"ns_stddev\":%.2f,\"ns_p90\":%.2f,\"cycles_median\":%.1f",
+            bench->name, (unsigned long long) iters, opts->samples, ns[0], median, mean, stddev,
+            percentile(ns, opts->samples, 0.9), percentile(cyc, opts->samples, 0.5));
+    if (bench->bytes != 0) fprintf(opts->out, ",\"bytes\":%llu,\"gbps\":%.3f", (unsigned long long) bench->bytes,
+                                   bench->bytes / median);
+    fprintf(opts->out, "}\n");
+    fflush(opts->out);
+
+    fprintf(stderr, "%-36s %12.1f ns/op  +/- %5.1f%%  %10.0f cycles", bench->name, median,
+            mean == 0 ? 0 : stddev / mean * 100, percentile(cyc, opts->samples, 0.5));
+    if (bench->bytes != 0) fprintf(stderr, "  %7.3f GB/s", bench->bytes / median);
+    fprintf(stderr, "\n");
+
+    free(ns);
+    free(cyc);
+}
+
+static const Bench* benches[256];
+static int benchNum = 0;
+
+void Bench_register(const Bench* bench) {
+    if (benchNum < 256) benches[benchNum++] = bench;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "usage: %s [-f filter] [-s samples] [-w warmup] [-t min sample ms] [-o out.jsonl]\n", name);
+}
+
+int main(int argc, char** argv) {
+    BenchOptions opts = { .warmup = 3, .samples = 20, .minSampleNs = 10e6 };
+    const char* outPath = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:s:w:t:o:")) != -1) {
+        switch (opt) {
+        case 'f':
+            opts.filter = optarg;
+            break;
+        case 's':
+            opts.samples = atoi(optarg);
+            break;
+        case 'w':
+            opts.warmup = atoi(optarg);
+            break;
+        case 't':
+            opts.minSampleNs = atof(optarg) * 1e6;
+            break;
+        case 'o':
+            outPath = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (opts.samples < 1) opts.samples = 1;
+
+    // the results keep the real stdout, what the benchmarks print goes to /dev/null
+    opts.out = outPath != NULL ? fopen(outPath, "w") : fdopen(dup(STDOUT_FILENO), "w");
+    if (opts.out == NULL || freopen("/dev/null", "w", stdout) == NULL) {
+        perror("open output");
+        return 1;
+    }
+
+    Bench_registerChess();
+    Bench_registerJson();
+    for (int i = 0; i < benchNum; i++) {
+        Bench_run(benches[i], &opts);
+    }
+    fclose(opts.out);
+    return 0;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+
+// a benchmark runs its operation `iters` times on every call
+typedef void (*BenchFn)(void* arg, uint64_t iters);
+
+typedef struct {
+    const char* name;
+    BenchFn fn;
+    void* arg;
+    uint64_t bytes;  // bytes processed by one operation, 0 if throughput makes no sense
+} Bench;
+
+typedef struct {
+    int warmup;         // samples thrown away before measuring
+    int samples;        // measured samples
+    double minSampleNs; // iterations per sample are raised until a sample takes this long
+    const char* filter; // only run the benchmarks whose name contains it
+    FILE* out;          // one JSON object per benchmark
+} BenchOptions;
+
+void Bench_run(const Bench* bench, const BenchOptions* opts);
+// the bench must stay alive, main runs every registered bench in order
+void Bench_register(const Bench* bench);
+// keep the compiler from dropping a result nobody reads
+void Bench_consume(uint64_t v);
+
+void Bench_registerChess(void);
+void Bench_registerJson(void);
@@ -0,0 +1,191 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "bench.h"
+#include "chess.h"
+#include "search.h"
+#include "shmring.h"
+#include "snapshot.h"
+
+typedef struct {
+    const char* fen;
+    const char* move;
+    GameState* game;
+    GameState* scratch;
+} Position;
+
+static Position opening = { .fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w", .move = "e2e4" };
+static Position middlegame = { .fen = "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R2QKB1R w", .move = "f3e5" };
+static Position endgame = { .fen = "8/5k2/8/3R4/8/2K5/8/8 w", .move = "d5d4" };
+
+static void load(Position* p) {
+    p->game = malloc(sizeof(GameState));
+    p->scratch = malloc(sizeof(GameState));
+    // a rejected move would only time the error path
+    if (Game_fromFen(p->game, p->fen) != 0) exit(1);
+    memcpy(p->scratch, p->game, sizeof(GameState));
+    if (Game_exec(p->scratch, p->move) != Success) {
+        fprintf(stderr, "bad bench position %s %s\n", p->fen, p->move);
+        exit(1);
+    }
+}
+
+static void bench_init(void* arg, uint64_t iters) {
+    GameState* game = arg;
+    for (uint64_t i = 0; i < iters; i++) {
+        InitGame(game);
+        Bench_consume(game->board[i & 63].isEmpty);
+    }
+}
+
+// every move starts from the same position, restoring it is part of the cost
+static void bench_exec(void* arg, uint64_t iters) {
+    Position* p = arg;
+    for (uint64_t i = 0; i < iters; i++) {
+        memcpy(p->scratch, p->game, offsetof(GameState, history));
+        Bench_consume(Game_exec(p->scratch, p->move));
+    }
+}
+
+static void bench_check(void* arg, uint64_t iters) {
+    Position* p = arg;
+    for (uint64_t i = 0; i < iters; i++) {
+        Bench_consume(Game_isCheck(p->game, i & 1 ? White : Black));
+    }
+}
+
+static void bench_moves(void* arg, uint64_t iters) {
+    Position* p = arg;
+    Step moves[256];
+    for (uint64_t i = 0; i < iters; i++) {
+        Bench_consume(Game_legalMoves(p->game, moves, 256));
+    }
+}
+
+static void bench_debug(void* arg, uint64_t iters) {
+    Position* p = arg;
+    for (uint64_t i = 0; i < iters; i++) {
+        Game_debug(p->game);
+    }
+}
+
+static void bench_search(void* arg, uint64_t iters) {
+    Position* p = arg;
+    SearchConfig cfg = { .depth = 2 };
+    for (uint64_t i = 0; i < iters; i++) {
+        SearchResult res;
+        Search_run(p->game, &cfg, &res);
+        Bench_consume(res.nodes);
+    }
+}
+
+typedef struct {
+    GameState* game;
+    char moves[MAXSTEPS][5];
+    int plies;
+    JsonDoc* snap;
+} Replay;
+
+// a game picked from the legal moves without search, long enough that replaying it costs
+static void make_replay(Replay* r, int plies) {
+    GameState* game = malloc(sizeof(GameState));
+    InitGame(game);
+    Step moves[256];
+    for (r->plies = 0; r->plies < plies && !game->isFinished; r->plies++) {
+        int n = Game_legalMoves(game, moves, 256);
+        Step_tostr(&moves[r->plies * 7919 % n], r->moves[r->plies]);
+        if (Game_exec(game, r->moves[r->plies]) != Success) exit(1);
+    }
+    JsonWriter w;
+    jwriter_init_grow(&w, 4096);
+    if (Snapshot_write(game, &w) != 0) exit(1);
+    r->snap = minijson_parse_str(w.buf, w.len, NULL);
+    if (r->snap == NULL) exit(1);
+    jwriter_free(&w);
+    r->game = game;
+}
+
+static void bench_restore(void* arg, uint64_t iters) {
+    Replay* r = arg;
+    for (uint64_t i = 0; i < iters; i++) {
+        if (Snapshot_restore(r->game, &r->snap->root) != 0) abort();
+        Bench_consume(r->game->stepNum);
+    }
+}
+
+// what a restore without snapshots costs, every move is checked again
+static void bench_replay(void* arg, uint64_t iters) {
+    Replay* r = arg;
+    for (uint64_t i = 0; i < iters; i++) {
+        InitGame(r->game);
+        for (int m = 0; m < r->plies; m++) Game_exec(r->game, r->moves[m]);
+        Bench_consume(r->game->stepNum);
+    }
+}
+
+static ShmRing ring;
+static ShmRing ringReader;
+
+static void bench_publish(void* arg, uint64_t iters) {
+    Position* p = arg;
+    for (uint64_t i = 0; i < iters; i++) {
+        ShmRing_publish(&ring, p->game);
+    }
+    Bench_consume(ShmRing_version(&ring));
+}
+
+// a reader of its own mapping, like another process would have
+static void bench_latest(void* arg, uint64_t iters) {
+    ShmPosition pos;
+    for (uint64_t i = 0; i < iters; i++) {
+        Bench_consume(ShmRing_latest(&ringReader, &pos) ? pos.ply : 0);
+    }
+}
+
+void Bench_registerChess(void) {
+    static GameState initGame;
+    load(&opening);
+    load(&middlegame);
+    load(&endgame);
+
+    static const Bench benches[] = {
+        { "chess/InitGame", bench_init, &initGame },
+        { "chess/Game_exec/opening", bench_exec, &opening },
+        { "chess/Game_exec/middlegame", bench_exec, &middlegame },
+        { "chess/Game_exec/endgame", bench_exec, &endgame },
+        { "chess/Game_isCheck/middlegame", bench_check, &middlegame },
+        { "chess/Game_legalMoves/opening", bench_moves, &opening },
+        { "chess/Game_legalMoves/middlegame", bench_moves, &middlegame },
+        { "chess/Game_legalMoves/endgame", bench_moves, &endgame },
+        { "chess/Game_debug/middlegame", bench_debug, &middlegame },
+        { "chess/Search_run/depth2/middlegame", bench_search, &middlegame },
+    };
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        Bench_register(&benches[i]);
+    }
+
+    static Replay replay;
+    make_replay(&replay, 120);
+    static const Bench snapshotBenches[] = {
+        { "chess/Snapshot_restore/game", bench_restore, &replay },
+        { "chess/replay/game", bench_replay, &replay },
+    };
+    Bench_register(&snapshotBenches[0]);
+    Bench_register(&snapshotBenches[1]);
+
+    char name[64];
+    snprintf(name, sizeof(name), "/minibench_%d", (int) getpid());
+    if (ShmRing_create(&ring, name, 64) != 0 || ShmRing_open(&ringReader, name) != 0) exit(1);
+    ShmRing_publish(&ring, middlegame.game);
+    // the name is not needed once both mappings exist
+    shm_unlink(name);
+    static const Bench ringBenches[] = {
+        { "chess/ShmRing_publish/middlegame", bench_publish, &middlegame },
+        { "chess/ShmRing_latest", bench_latest, NULL },
+    };
+    Bench_register(&ringBenches[0]);
+    Bench_register(&ringBenches[1]);
+}
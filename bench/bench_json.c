@@ -0,0 +1,262 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "minijson.h"
+
+typedef struct {
+    char* data;
+    int len;
+} Doc;
+
+static Doc mixed, strings, numbers;
+
+static void doc_append(Doc* d, int* cap, const char* s) {
+    int n = strlen(s);
+    if (d->len + n + 1 > *cap) {
+        *cap = (*cap + n + 1) * 2;
+        d->data = realloc(d->data, *cap);
+    }
+    memcpy(d->data + d->len, s, n + 1);
+    d->len += n;
+}
+
+// records shaped like game snapshots
+static void make_mixed(Doc* d, int records) {
+    int cap = 0;
+    char buf[512];
+    doc_append(d, &cap, "[");
+    for (int i = 0; i < records; i++) {
+        snprintf(buf, sizeof(buf),
+                 "%s{\"id\": %d, \"turn\": \"%s\", \"finished\": %s, \"score\": %.3f, \"winner\": null, "
+                 "\"fen\": \"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b - - 0 1\", "
+                 "\"moves\": [\"e2e4\", \"e7e5\", \"g1f3\", \"b8c6\"], \"clock\": {\"white\": %d, \"black\": %d}}",
+                 i == 0 ? "" : ",\n", i, i % 2 ? "black" : "white", i % 7 == 0 ? "true" : "false", i * 0.125,
+                 300000 - i, 299000 + i);
+        doc_append(d, &cap, buf);
+    }
+    doc_append(d, &cap, "]");
+}
+
+static void make_strings(Doc* d, int records) {
+    int cap = 0;
+    char buf[512];
+    doc_append(d, &cap, "[");
+    for (int i = 0; i < records; i++) {
+        snprintf(buf, sizeof(buf),
+                 "%s\"player %d said: \\\"good game\\\" and left the room after a long endgame\", "
+                 "\"plain ascii text without any escapes at all, just a comment about move %d\"",
+                 i == 0 ? "" : ", ", i, i);
+        doc_append(d, &cap, buf);
+    }
+    doc_append(d, &cap, "]");
+}
+
+static void make_numbers(Doc* d, int records) {
+    int cap = 0;
+    char buf[128];
+    doc_append(d, &cap, "[");
+    for (int i = 0; i < records; i++) {
+        snprintf(buf, sizeof(buf), "%s%d, %.17g, %de%d", i == 0 ? "" : ", ", i * 7919, i / 3.0, i, i % 30);
+        doc_append(d, &cap, buf);
+    }
+    doc_append(d, &cap, "]");
+}
+
+typedef struct {
+    Doc* doc;
+    JsonScanKind scan;
+    bool view;
+} ParseArg;
+
+static void bench_parse(void* arg, uint64_t iters) {
+    ParseArg* a = arg;
+    minijson_set_scan(a->scan);
+    for (uint64_t i = 0; i < iters; i++) {
+        JsonDoc* doc = a->view ? minijson_parse_view(a->doc->data, a->doc->len, NULL)
+                               : minijson_parse_str(a->doc->data, a->doc->len, NULL);
+        if (doc == NULL) abort();
+        Bench_consume(doc->root.jsonArray.length);
+        minijson_free(doc);
+    }
+    minijson_set_scan(JsonScanAuto);
+}
+
+static int sax_value(void* ctx, const JsonBaseObj* value) {
+    (*(uint64_t*) ctx)++;
+    return 0;
+}
+
+// the document arrives in socket sized chunks and only the values are counted
+static void bench_sax(void* arg, uint64_t iters) {
+    Doc* d = arg;
+    for (uint64_t i = 0; i < iters; i++) {
+        uint64_t values = 0;
+        JsonSaxHandler h = { .ctx = &values, .value = sax_value };
+        JsonSax* sax = minijson_sax_new(&h);
+        for (int off = 0; off < d->len; off += 65536) {
+            if (minijson_sax_feed(sax, d->data + off, d->len - off < 65536 ? d->len - off : 65536) != 0) abort();
+        }
+        if (minijson_sax_finish(sax) != 0) abort();
+        Bench_consume(values);
+        minijson_sax_free(sax);
+    }
+}
+
+typedef struct {
+    JsonMap map;
+    char keys[512][24];
+    int keyLens[512];
+} MapArg;
+
+// every key of the map once per operation
+static void bench_map_get(void* arg, uint64_t iters) {
+    MapArg* a = arg;
+    for (uint64_t i = 0; i < iters; i++) {
+        uint64_t sum = 0;
+        for (int k = 0; k < a->map.len; k++) {
+            sum += minijson_map_get(&a->map, a->keys[k], a->keyLens[k])->jsonNum.Int64;
+        }
+        Bench_consume(sum);
+    }
+}
+
+static void make_map(MapArg* a, int keys, bool indexed) {
+    char* src = malloc(keys * 40 + 16);
+    int n = sprintf(src, "{");
+    for (int k = 0; k < keys; k++) {
+        a->keyLens[k] = sprintf(a->keys[k], "config.key%d", k * 7919);
+        n += sprintf(src + n, "%s\"%s\": %d", k ? ", " : "", a->keys[k], k);
+    }
+    sprintf(src + n, "}");
+    // the document is kept for the whole run
+    JsonDoc* doc = minijson_parse_str(src, n + 1, NULL);
+    if (doc == NULL) abort();
+    free(src);
+    a->map = doc->root.jsonMap;
+    if (!indexed) a->map.index = NULL;
+}
+
+typedef struct {
+    JsonDoc* doc;
+    JsonWriter w;
+} WriteArg;
+
+// the writer buffer is kept between operations like a server reusing its output buffer
+static void bench_write(void* arg, uint64_t iters) {
+    WriteArg* a = arg;
+    for (uint64_t i = 0; i < iters; i++) {
+        a->w.len = 0;
+        if (jwriter_value(&a->w, &a->doc->root) != 0) abort();
+        Bench_consume(a->w.len);
+    }
+}
+
+static double doubles[1024];
+
+static void bench_format_double(void* arg, uint64_t iters) {
+    char buf[32];
+    for (uint64_t i = 0; i < iters; i++) {
+        JsonWriter w;
+        jwriter_init(&w, buf, sizeof(buf));
+        jwriter_double(&w, doubles[i & 1023]);
+        Bench_consume(w.len);
+    }
+}
+
+// what the serializer replaces, the shortest round trip is usually shorter than %.17g
+static void bench_printf_double(void* arg, uint64_t iters) {
+    char buf[32];
+    for (uint64_t i = 0; i < iters; i++) {
+        Bench_consume(snprintf(buf, sizeof(buf), "%.17g", doubles[i & 1023]));
+    }
+}
+
+void Bench_registerJson(void) {
+    make_mixed(&mixed, 2000);
+    make_strings(&strings, 4000);
+    make_numbers(&numbers, 10000);
+
+    // every document on every structural scan the cpu supports
+    static const struct {
+        const char* name;
+        Doc* doc;
+    } docs[] = { { "mixed", &mixed }, { "strings", &strings }, { "numbers", &numbers } };
+    static const struct {
+        const char* name;
+        JsonScanKind kind;
+    } scans[] = { { "scalar", JsonScanScalar }, { "sse2", JsonScanSse2 }, { "avx2", JsonScanAvx2 } };
+    static char names[3][3][64];
+    static ParseArg args[3][3];
+    static Bench benches[3][3];
+    for (int d = 0; d < 3; d++) {
+        for (int k = 0; k < 3; k++) {
+            if (minijson_set_scan(scans[k].kind) != scans[k].kind) continue;
+            snprintf(names[d][k], sizeof(names[d][k]), "minijson/parse/%s/%s", docs[d].name, scans[k].name);
+            args[d][k] = (ParseArg){ docs[d].doc, scans[k].kind, false };
+            benches[d][k] = (Bench){ names[d][k], bench_parse, &args[d][k], docs[d].doc->len };
+            Bench_register(&benches[d][k]);
+        }
+    }
+    minijson_set_scan(JsonScanAuto);
+
+    // strings as views into the input instead of copies
+    static char viewNames[3][64];
+    static ParseArg viewArgs[3];
+    static Bench viewBenches[3];
+    for (int d = 0; d < 3; d++) {
+        snprintf(viewNames[d], sizeof(viewNames[d]), "minijson/view/%s", docs[d].name);
+        viewArgs[d] = (ParseArg){ docs[d].doc, JsonScanAuto, true };
+        viewBenches[d] = (Bench){ viewNames[d], bench_parse, &viewArgs[d], docs[d].doc->len };
+        Bench_register(&viewBenches[d]);
+    }
+
+    static char saxNames[3][64];
+    static Bench saxBenches[3];
+    for (int d = 0; d < 3; d++) {
+        snprintf(saxNames[d], sizeof(saxNames[d]), "minijson/sax/%s", docs[d].name);
+        saxBenches[d] = (Bench){ saxNames[d], bench_sax, docs[d].doc, docs[d].doc->len };
+        Bench_register(&saxBenches[d]);
+    }
+
+    // lookups with the hash index against the same map searched in order
+    static const struct {
+        const char* name;
+        int keys;
+        bool indexed;
+    } maps[] = { { "minijson/map_get/8", 8, true },
+                 { "minijson/map_get/64", 64, true },
+                 { "minijson/map_get/64/linear", 64, false },
+                 { "minijson/map_get/512", 512, true },
+                 { "minijson/map_get/512/linear", 512, false } };
+    static MapArg mapArgs[5];
+    static Bench mapBenches[5];
+    for (int m = 0; m < 5; m++) {
+        make_map(&mapArgs[m], maps[m].keys, maps[m].indexed);
+        mapBenches[m] = (Bench){ maps[m].name, bench_map_get, &mapArgs[m], 0 };
+        Bench_register(&mapBenches[m]);
+    }
+
+    static WriteArg writeArgs[3];
+    static char writeNames[3][64];
+    static Bench writeBenches[3];
+    for (int d = 0; d < 3; d++) {
+        writeArgs[d].doc = minijson_parse_str(docs[d].doc->data, docs[d].doc->len, NULL);
+        if (writeArgs[d].doc == NULL) abort();
+        jwriter_init_grow(&writeArgs[d].w, 4096);
+        jwriter_value(&writeArgs[d].w, &writeArgs[d].doc->root);
+        snprintf(writeNames[d], sizeof(writeNames[d]), "minijson/write/%s", docs[d].name);
+        // throughput counts the written bytes
+        writeBenches[d] = (Bench){ writeNames[d], bench_write, &writeArgs[d], writeArgs[d].w.len };
+        Bench_register(&writeBenches[d]);
+    }
+
+    for (int i = 0; i < 1024; i++) doubles[i] = (i * 7919 % 100003) / 3.0 * (i % 2 ? 1e-5 : 1e7);
+    static Bench doubleBenches[] = {
+        { "minijson/double/shortest", bench_format_double, NULL },
+        { "minijson/double/printf17g", bench_printf_double, NULL },
+    };
+    Bench_register(&doubleBenches[0]);
+    Bench_register(&doubleBenches[1]);
+}
@@ -1,8 +1,11 @@
 #include "chess.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "profile.h"
+#include "tablebase.h"
 
 static const Elem* findElem(const GameState* game, Vec2 p);
 
@@ -105,6 +108,14 @@ static PieceRule PRuleTable[] = {
     [Bishop] = bishopRule, [Knight] = knightRule, [Pawn] = pawnRule,
 };
 
+// every rule of PRuleTable is invoked through here so it can be profiled per piece
+static Response runRule(const GameState* game, Piece p, Step* step) {
+    PROF_BEGIN();
+    Response res = PRuleTable[p](game, step);
+    PROF_END(ProfRuleKing + p);
+    return res;
+}
+
 static Response kingRule(const GameState* game, Step* step) {
     if (Vec2_hasAbsDiff(step->to, step->from, 1, 1)) return Success;
     if (Vec2_hasAbsDiff(step->to, step->from, 1, 0)) return Success;
@@ -285,6 +296,67 @@ void Game_debug(GameState* game) {
     printf("  A B C D E F G H\n");
 }
 
+// only the placement and the side to move are used, the other fields are written as defaults
+int Game_fromFen(GameState* game, const char* fen) {
+    InitGame(game);
+    for (int i = 0; i < 64; i++) {
+        game->board[i].isEmpty = true;
+    }
+
+    int x = 0, y = 7;
+    const char* c = fen;
+    for (; *c != '\0' && *c != ' '; c++) {
+        if (*c == '/') {
+            if (x != 8 || y == 0) return -1;
+            x = 0;
+            y--;
+        } else if ('1' <= *c && *c <= '8') {
+            x += *c - '0';
+            if (x > 8) return -1;
+        } else {
+            int p = 0;
+            while (p < 6 && piece_simp_names[p] != (*c & ~0x20)) {
+                p++;
+            }
+            if (p == 6 || x >= 8) return -1;
+            _initPiece(game, x, y, p, *c >= 'a' ? Black : White);
+            x++;
+        }
+    }
+    if (x != 8 || y != 0) return -1;
+
+    while (*c == ' ') {
+        c++;
+    }
+    // the side to move is a field of its own, "wx" or a missing field is refused
+    if (*c != 'w' && *c != 'b') return -1;
+    if (c[1] != '\0' && c[1] != ' ' && c[1] != '\t' && c[1] != '\r' && c[1] != '\n') return -1;
+    game->turn = *c == 'b' ? Black : White;
+    return 0;
+}
+
+int Game_toFen(const GameState* game, char* buf, int len) {
+    char fen[100];
+    int n = 0;
+    for (int y = 7; y >= 0; y--) {
+        int empty = 0;
+        for (int x = 0; x < 8; x++) {
+            const Elem* e = &game->board[x + 8 * y];
+            if (e->isEmpty) {
+                empty++;
+                continue;
+            }
+            if (empty != 0) fen[n++] = '0' + empty;
+            empty = 0;
+            fen[n++] = piece_simp_names[e->piece] | (e->team == Black ? 0x20 : 0);
+        }
+        if (empty != 0) fen[n++] = '0' + empty;
+        if (y != 0) fen[n++] = '/';
+    }
+    fen[n] = '\0';
+    return snprintf(buf, len, "%s %c - - 0 %d", fen, game->turn == White ? 'w' : 'b', game->stepNum / 2 + 1);
+}
+
 static int parse_Pos(const char* str, Vec2* from, Vec2* to) {
     if (strlen(str) < 4) {
         return -1;
@@ -321,11 +393,12 @@ static Elem* findElemMut(GameState* game, Vec2 p) {
     return &game->board[p.x + 8 * p.y];
 }
 
+// copy the position only, the history is left out since checking a move never reads it
 static void Game_copy(GameState* dist, const GameState* src) {
-    memcpy(dist, src, sizeof(GameState));
+    memcpy(dist, src, offsetof(GameState, history));
 }
 
-static int Game_doStep(GameState* game, const Step* step) {
+int Game_doStep(GameState* game, const Step* step) {
     game->turn = game->turn == White ? Black : White;
     game->stepNum++;
 
@@ -338,11 +411,11 @@ static int Game_doStep(GameState* game, const Step* step) {
     return 0;
 }
 
-static bool Game_isCheck(GameState* game, Team team) {
+static bool _isCheck(const GameState* game, Team team) {
     Vec2 kingPos;
     bool findKing = false;
     for (int i = 0; i < 64; i++) {
-        Elem* temp = &game->board[i];
+        const Elem* temp = &game->board[i];
         if (!temp->isEmpty && temp->piece == King && temp->team == team) {
             kingPos.x = i % 8;
             kingPos.y = i / 8;
@@ -353,7 +426,7 @@ static bool Game_isCheck(GameState* game, Team team) {
 
     for (int i = 0; i < 64; i++) {
         Vec2 from;
-        Elem* temp = &game->board[i];
+        const Elem* temp = &game->board[i];
         if (!temp->isEmpty && temp->team != team) {
             from.x = i % 8;
             from.y = i / 8;
@@ -362,15 +435,21 @@ static bool Game_isCheck(GameState* game, Team team) {
         }
 
         Step step = { .from = from, .to = kingPos };
-        PieceRule rule = PRuleTable[temp->piece];
-        Response res = rule(game, &step);
+        Response res = runRule(game, temp->piece, &step);
         if (res == Success) return true;
     }
 
     return false;
 }
 
-static Response Game_isLegalMove(const GameState* game, Step* step) {
+bool Game_isCheck(const GameState* game, Team team) {
+    PROF_BEGIN();
+    bool res = _isCheck(game, team);
+    PROF_END(ProfIsCheck);
+    return res;
+}
+
+static Response _isLegalMove(const GameState* game, Step* step) {
     const Elem* temp = findElem(game, step->from);
     if (temp->isEmpty) return ErrNoPieceThere;
     if (temp->team != game->turn) return ErrNotYourTurn;
@@ -381,8 +460,7 @@ static Response Game_isLegalMove(const GameState* game, Step* step) {
     const Elem* toElem = findElem(game, step->to);
     if (!toElem->isEmpty && toElem->team == step->turn) return ErrBlocked;
 
-    PieceRule rule = PRuleTable[step->p];
-    Response res = rule(game, step);
+    Response res = runRule(game, step->p, step);
     if (res != Success) return res;
 
     GameState newState;
@@ -394,12 +472,18 @@ static Response Game_isLegalMove(const GameState* game, Step* step) {
     return Success;
 }
 
+Response Game_isLegalMove(const GameState* game, Step* step) {
+    PROF_BEGIN();
+    Response res = _isLegalMove(game, step);
+    PROF_END(ProfIsLegalMove);
+    return res;
+}
+
 static int possibleMoves(const GameState* game, Vec2 pos, Step result[], int maxLen) {
     int resultNum = 0;
 
     const Elem* elem = findElem(game, pos);
     if (elem == NULL && elem->isEmpty == true) return 0;
-    PieceRule rule = PRuleTable[elem->piece];
 
     for (int i = 0; i < 64 && resultNum < maxLen; i++) {
         Vec2 to = { .x = i % 8, .y = i / 8 };
@@ -413,7 +497,7 @@ static int possibleMoves(const GameState* game, Vec2 pos, Step result[], int max
     return resultNum;
 }
 
-static bool Game_hasLegalMove(const GameState* game) {
+static bool _hasLegalMove(const GameState* game) {
     for (int i = 0; i < 64; i++) {
         Vec2 pos = { .x = i % 8, .y = i / 8 };
         const Elem* elem = findElem(game, pos);
@@ -426,28 +510,96 @@ static bool Game_hasLegalMove(const GameState* game) {
     return false;
 }
 
+bool Game_hasLegalMove(const GameState* game) {
+    PROF_BEGIN();
+    bool res = _hasLegalMove(game);
+    PROF_END(ProfHasLegalMove);
+    return res;
+}
+
+int Game_legalMoves(const GameState* game, Step result[], int maxLen) {
+    int resultNum = 0;
+    for (int i = 0; i < 64 && resultNum < maxLen; i++) {
+        Vec2 pos = { .x = i % 8, .y = i / 8 };
+        const Elem* elem = findElem(game, pos);
+        if (!elem->isEmpty && elem->team == game->turn) {
+            resultNum += possibleMoves(game, pos, result + resultNum, maxLen - resultNum);
+        }
+    }
+    return resultNum;
+}
+
+Response Game_checkPieceRule(const GameState* game, Step* step) {
+    const Elem* elem = findElem(game, step->from);
+    if (elem->isEmpty) return ErrNoPieceThere;
+    return runRule(game, elem->piece, step);
+}
+
+void Step_tostr(const Step* step, char str[5]) {
+    str[0] = 'a' + step->from.x;
+    str[1] = '1' + step->from.y;
+    str[2] = 'a' + step->to.x;
+    str[3] = '1' + step->to.y;
+    str[4] = '\0';
+}
+
 Response Game_exec(GameState* game, const char* const cmd) {
     Step step;
 
     int err = parse_Pos(cmd, &step.from, &step.to);
     if (err != 0) return ErrParseCmd;
-    Response resp = Game_isLegalMove(game, &step);
+    return Game_execStep(game, &step);
+}
+
+static Response _execStep(GameState* game, Step* step) {
+    if (game->isFinished) return ErrAlreadyFinish;
+    Response resp = Game_isLegalMove(game, step);
     if (resp != Success) {
         return resp;
     }
 
+    const Elem* toElem = findElem(game, step->to);
+    step->isEat = !toElem->isEmpty;
+    step->died = toElem->piece;
+    step->isPrompt = false;
+    step->isCastle = false;
+    step->isEnpass = false;
+    step->isCheckMate = false;
+    if (game->stepNum < MAXSTEPS) game->history[game->stepNum] = *step;
+
     // finally all check is done ,we need change the game state
-    Game_doStep(game, &step);
+    Game_doStep(game, step);
     // check if the game is finished
     if (Game_isCheck(game, game->turn)) {
         if (!Game_hasLegalMove(game)) {
             game->isFinished = true;
-            game->winner = game->turn;
+            game->winner = game->turn == White ? Black : White;
+            game->history[game->stepNum - 1].isCheckMate = true;
         }
     } else if (!Game_hasLegalMove(game)) {
         game->isFinished = true;
         game->winner = NoTeam;
+    } else {
+        // no mate can be forced from here by either side, finish it as a draw
+        TbResult tb;
+        if (Tablebase_probe(game, &tb) && tb.value == TbDraw) {
+            game->isFinished = true;
+            game->winner = NoTeam;
+        }
+    }
+
+    // the history is full, call it a draw
+    if (!game->isFinished && game->stepNum >= MAXSTEPS) {
+        game->isFinished = true;
+        game->winner = NoTeam;
     }
 
     return Success;
 }
+
+Response Game_execStep(GameState* game, Step* step) {
+    PROF_BEGIN();
+    Response res = _execStep(game, step);
+    PROF_END(ProfExec);
+    return res;
+}
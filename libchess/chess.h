@@ -73,4 +73,17 @@ typedef struct {
 void InitGame(GameState* game);
 void Game_debug(GameState* game);
 Response Game_exec(GameState* game, const char* const cmd);
+Response Game_execStep(GameState* game, Step* step);
 const char* Response_tostr(Response r);
+void Step_tostr(const Step* step, char str[5]);
+int Game_fromFen(GameState* game, const char* fen);
+int Game_toFen(const GameState* game, char* buf, int len);
+
+bool Game_isCheck(const GameState* game, Team team);
+Response Game_isLegalMove(const GameState* game, Step* step);
+bool Game_hasLegalMove(const GameState* game);
+int Game_legalMoves(const GameState* game, Step result[], int maxLen);
+// apply an already legal step, no check and no history
+int Game_doStep(GameState* game, const Step* step);
+// only check the moving rule of the piece at step->from, turn and self-check are ignored
+Response Game_checkPieceRule(const GameState* game, Step* step);
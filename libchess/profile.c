@@ -0,0 +1,150 @@
+#include "profile.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+static const char* prof_names[] = {
+    [ProfExec] = "Game_exec",
+    [ProfIsLegalMove] = "Game_isLegalMove",
+    [ProfIsCheck] = "Game_isCheck",
+    [ProfHasLegalMove] = "Game_hasLegalMove",
+    [ProfRuleKing] = "kingRule",
+    [ProfRuleQueen] = "queenRule",
+    [ProfRuleRook] = "rookRule",
+    [ProfRuleBishop] = "bishopRule",
+    [ProfRuleKnight] = "knightRule",
+    [ProfRulePawn] = "pawnRule",
+};
+
+#ifdef CHESS_PROFILE
+
+#define PROF_BUCKETS 40
+
+// only the owner thread writes its counters, the dump reads them without stopping it
+typedef struct ProfThread {
+    uint64_t gen;  // the reset the counters belong to
+    uint64_t calls[ProfIdNum];
+    uint64_t ticks[ProfIdNum];
+    uint64_t hist[ProfIdNum][PROF_BUCKETS];  // bucket b holds the latencies below 2^b ticks
+    struct ProfThread* next;
+} ProfThread;
+
+static _Thread_local ProfThread* self = NULL;
+static ProfThread* threads = NULL;
+static pthread_mutex_t threadsLock = PTHREAD_MUTEX_INITIALIZER;
+// bumped by a reset, each owner clears its own counters when it sees the new value
+static uint64_t resetGen = 0;
+static uint64_t startTicks;
+static struct timespec startTime;
+
+static ProfThread* prof_register() {
+    ProfThread* t = calloc(1, sizeof(ProfThread));
+    if (t == NULL) abort();
+    pthread_mutex_lock(&threadsLock);
+    if (threads == NULL) {
+        startTicks = Prof_now();
+        clock_gettime(CLOCK_MONOTONIC, &startTime);
+    }
+    t->gen = __atomic_load_n(&resetGen, __ATOMIC_RELAXED);
+    t->next = threads;
+    threads = t;
+    pthread_mutex_unlock(&threadsLock);
+    return t;
+}
+
+// a plain add, no locked instruction is needed as nobody else writes the counter
+static inline void bump(uint64_t* counter, uint64_t v) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + v, __ATOMIC_RELAXED);
+}
+
+// the owner zeroes its counters itself, a reset can then never race with a bump
+static void prof_catch_up(ProfThread* t, uint64_t gen) {
+    for (int id = 0; id < ProfIdNum; id++) {
+        __atomic_store_n(&t->calls[id], 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&t->ticks[id], 0, __ATOMIC_RELAXED);
+        for (int b = 0; b < PROF_BUCKETS; b++) {
+            __atomic_store_n(&t->hist[id][b], 0, __ATOMIC_RELAXED);
+        }
+    }
+    __atomic_store_n(&t->gen, gen, __ATOMIC_RELEASE);
+}
+
+void Prof_record(ProfId id, uint64_t ticks) {
+    ProfThread* t = self;
+    if (t == NULL) t = self = prof_register();
+    uint64_t gen = __atomic_load_n(&resetGen, __ATOMIC_RELAXED);
+    if (t->gen != gen) prof_catch_up(t, gen);
+    bump(&t->calls[id], 1);
+    bump(&t->ticks[id], ticks);
+    int b = ticks == 0 ? 0 : 64 - __builtin_clzll(ticks);
+    if (b >= PROF_BUCKETS) b = PROF_BUCKETS - 1;
+    bump(&t->hist[id][b], 1);
+}
+
+static double ns_per_tick() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t ticks = Prof_now() - startTicks;
+    double ns = (now.tv_sec - startTime.tv_sec) * 1e9 + (now.tv_nsec - startTime.tv_nsec);
+    return ticks == 0 ? 1 : ns / ticks;
+}
+
+static double quantile(const uint64_t hist[], uint64_t calls, double q) {
+    uint64_t want = calls * q;
+    uint64_t seen = 0;
+    for (int b = 0; b < PROF_BUCKETS; b++) {
+        seen += hist[b];
+        if (seen > want) return (double) (1ull << b);
+    }
+    return (double) (1ull << (PROF_BUCKETS - 1));
+}
+
+void Prof_dump(FILE* out) {
+    uint64_t calls[ProfIdNum] = { 0 };
+    uint64_t ticks[ProfIdNum] = { 0 };
+    uint64_t hist[ProfIdNum][PROF_BUCKETS] = { { 0 } };
+    int threadNum = 0;
+
+    pthread_mutex_lock(&threadsLock);
+    uint64_t gen = __atomic_load_n(&resetGen, __ATOMIC_RELAXED);
+    for (ProfThread* t = threads; t != NULL; t = t->next) {
+        threadNum++;
+        // the counters of a thread that has not seen the last reset yet are all from before it
+        if (__atomic_load_n(&t->gen, __ATOMIC_ACQUIRE) != gen) continue;
+        for (int id = 0; id < ProfIdNum; id++) {
+            calls[id] += __atomic_load_n(&t->calls[id], __ATOMIC_RELAXED);
+            ticks[id] += __atomic_load_n(&t->ticks[id], __ATOMIC_RELAXED);
+            for (int b = 0; b < PROF_BUCKETS; b++) {
+                hist[id][b] += __atomic_load_n(&t->hist[id][b], __ATOMIC_RELAXED);
+            }
+        }
+    }
+    double scale = threads == NULL ? 1 : ns_per_tick();
+    pthread_mutex_unlock(&threadsLock);
+
+    // the times are inclusive, Game_exec contains the calls it makes
+    fprintf(out, "%-18s %12s %12s %10s %10s %10s\n", "function", "calls", "total ms", "avg ns", "p50 ns<", "p99 ns<");
+    for (int id = 0; id < ProfIdNum; id++) {
+        if (calls[id] == 0) continue;
+        fprintf(out, "%-18s %12llu %12.3f %10.1f %10.0f %10.0f\n", prof_names[id], (unsigned long long) calls[id],
+                ticks[id] * scale / 1e6, ticks[id] * scale / calls[id], quantile(hist[id], calls[id], 0.5) * scale,
+                quantile(hist[id], calls[id], 0.99) * scale);
+    }
+    fprintf(out, "%d threads\n", threadNum);
+}
+
+void Prof_reset() {
+    __atomic_fetch_add(&resetGen, 1, __ATOMIC_RELAXED);
+}
+
+#else
+
+void Prof_dump(FILE* out) {
+    (void) prof_names;
+    fprintf(out, "libchess is built without CHESS_PROFILE, build with make PROFILE=1\n");
+}
+
+void Prof_reset() {
+}
+
+#endif
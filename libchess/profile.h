@@ -0,0 +1,50 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+
+// build with -DCHESS_PROFILE (make PROFILE=1) to count and time the hot paths of libchess,
+// otherwise the macros are empty and nothing is recorded
+
+typedef enum ProfId {
+    ProfExec,
+    ProfIsLegalMove,
+    ProfIsCheck,
+    ProfHasLegalMove,
+    ProfRuleKing,  // one per Piece, in the order of Piece
+    ProfRuleQueen,
+    ProfRuleRook,
+    ProfRuleBishop,
+    ProfRuleKnight,
+    ProfRulePawn,
+    ProfIdNum,
+} ProfId;
+
+#ifdef CHESS_PROFILE
+#define PROF_BEGIN() uint64_t _prof_begin = Prof_now()
+#define PROF_END(id) Prof_record(id, Prof_now() - _prof_begin)
+#else
+#define PROF_BEGIN()
+#define PROF_END(id)
+#endif
+
+#ifdef CHESS_PROFILE
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t Prof_now() {
+    return __rdtsc();
+}
+#else
+#include <time.h>
+static inline uint64_t Prof_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+#endif
+void Prof_record(ProfId id, uint64_t ticks);
+#endif
+
+// print the counters and latency histograms summed over all threads
+void Prof_dump(FILE* out);
+// drops the counts so far, a running thread clears its own counters on its next record
+void Prof_reset();
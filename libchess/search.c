@@ -0,0 +1,170 @@
+#include "search.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tablebase.h"
+
+#define SEARCH_INF (SEARCH_MATE + 1)
+#define SEARCH_MAXMOVES 256
+
+static const int piece_values[] = {
+    [King] = 0, [Queen] = 900, [Rook] = 500, [Bishop] = 330, [Knight] = 320, [Pawn] = 100,
+};
+
+typedef struct {
+    const SearchConfig* cfg;
+    GameState* stack;  // one position per ply, only the part before the history is used
+    uint64_t nodes;
+    bool stopped;
+    uint64_t rand;
+} Searcher;
+
+static uint64_t next_rand(Searcher* s) {
+    s->rand ^= s->rand << 13;
+    s->rand ^= s->rand >> 7;
+    s->rand ^= s->rand << 17;
+    return s->rand;
+}
+
+int Search_eval(const GameState* game) {
+    int score = 0;
+    for (int i = 0; i < 64; i++) {
+        const Elem* e = &game->board[i];
+        if (e->isEmpty) continue;
+        int x = i % 8;
+        int y = i / 8;
+        int v = piece_values[e->piece];
+        // knights and bishops like the center, pawns like to advance
+        if (e->piece == Knight || e->piece == Bishop) {
+            v += 10 - 2 * (abs(2 * x - 7) + abs(2 * y - 7)) / 2;
+        } else if (e->piece == Pawn) {
+            v += 5 * (e->team == White ? y - 1 : 6 - y);
+        }
+        score += e->team == game->turn ? v : -v;
+    }
+    return score;
+}
+
+static int victim_value(const GameState* game, const Step* step) {
+    const Elem* e = &game->board[step->to.x + 8 * step->to.y];
+    return e->isEmpty ? -1 : piece_values[e->piece];
+}
+
+// captures of the most valuable pieces first
+static void order_moves(const GameState* game, Step moves[], int num) {
+    int keys[SEARCH_MAXMOVES];
+    for (int i = 0; i < num; i++) {
+        keys[i] = victim_value(game, &moves[i]);
+    }
+    for (int i = 1; i < num; i++) {
+        Step m = moves[i];
+        int k = keys[i];
+        int j = i;
+        for (; j > 0 && keys[j - 1] < k; j--) {
+            moves[j] = moves[j - 1];
+            keys[j] = keys[j - 1];
+        }
+        moves[j] = m;
+        keys[j] = k;
+    }
+}
+
+static GameState* child_of(Searcher* s, int ply, const Step* step) {
+    GameState* child = &s->stack[ply + 1];
+    memcpy(child, &s->stack[ply], offsetof(GameState, history));
+    Game_doStep(child, step);
+    return child;
+}
+
+static int negamax(Searcher* s, int ply, int depth, int alpha, int beta) {
+    const GameState* game = &s->stack[ply];
+    s->nodes++;
+    if (s->cfg->maxNodes != 0 && s->nodes >= s->cfg->maxNodes) {
+        s->stopped = true;
+        return 0;
+    }
+
+    TbResult tb;
+    if (Tablebase_probe(game, &tb)) {
+        if (tb.value == TbWin) return SEARCH_MATE - ply - tb.dtm;
+        if (tb.value == TbLoss) return -(SEARCH_MATE - ply - tb.dtm);
+        return 0;
+    }
+    if (depth == 0) return Search_eval(game);
+
+    Step moves[SEARCH_MAXMOVES];
+    int num = Game_legalMoves(game, moves, SEARCH_MAXMOVES);
+    if (num == 0) return Game_isCheck(game, game->turn) ? -(SEARCH_MATE - ply) : 0;
+    order_moves(game, moves, num);
+
+    for (int i = 0; i < num; i++) {
+        child_of(s, ply, &moves[i]);
+        int score = -negamax(s, ply + 1, depth - 1, -beta, -alpha);
+        if (s->stopped) return 0;
+        if (score >= beta) return score;
+        if (score > alpha) alpha = score;
+    }
+    return alpha;
+}
+
+void Search_run(const GameState* game, const SearchConfig* cfg, SearchResult* res) {
+    memset(res, 0, sizeof(SearchResult));
+    int maxDepth = cfg->depth < 1 ? 1 : cfg->depth;
+    if (maxDepth > SEARCH_MAXDEPTH) maxDepth = SEARCH_MAXDEPTH;
+
+    Searcher s = { .cfg = cfg, .rand = cfg->seed != 0 ? cfg->seed : 0x9e3779b97f4a7c15ull };
+    s.stack = malloc((maxDepth + 1) * sizeof(GameState));
+    memcpy(&s.stack[0], game, offsetof(GameState, history));
+
+    Step moves[SEARCH_MAXMOVES];
+    int num = Game_legalMoves(game, moves, SEARCH_MAXMOVES);
+    if (num == 0) {
+        res->score = Game_isCheck(game, game->turn) ? -SEARCH_MATE : 0;
+        free(s.stack);
+        return;
+    }
+    order_moves(game, moves, num);
+
+    int noise[SEARCH_MAXMOVES];
+    for (int i = 0; i < num; i++) {
+        noise[i] = cfg->noise > 0 ? next_rand(&s) % (cfg->noise + 1) : 0;
+    }
+
+    // a node limit keeps the best move of the last finished iteration
+    for (int depth = 1; depth <= maxDepth; depth++) {
+        int alpha = -SEARCH_INF;
+        int best = -1;
+        int bestScore = -SEARCH_INF;
+        int bestRaw = 0;
+        for (int i = 0; i < num; i++) {
+            child_of(&s, 0, &moves[i]);
+            int bound = cfg->noise > 0 ? -SEARCH_INF : alpha;
+            int score = -negamax(&s, 1, depth - 1, -SEARCH_INF, -bound);
+            if (s.stopped) break;
+            if (score + noise[i] > bestScore) {
+                bestScore = score + noise[i];
+                best = i;
+                bestRaw = score;
+            }
+            if (score > alpha) alpha = score;
+        }
+        if (s.stopped && depth > 1) break;
+        if (best < 0) break;
+
+        res->hasMove = true;
+        res->best = moves[best];
+        res->score = bestRaw;
+        res->depth = depth;
+        // search the best move first in the next iteration
+        Step m = moves[best];
+        int n = noise[best];
+        memmove(&moves[1], &moves[0], best * sizeof(Step));
+        memmove(&noise[1], &noise[0], best * sizeof(int));
+        moves[0] = m;
+        noise[0] = n;
+        if (s.stopped) break;
+    }
+
+    res->nodes = s.nodes;
+    free(s.stack);
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "chess.h"
+
+#define SEARCH_MATE 100000
+#define SEARCH_MAXDEPTH 16
+
+typedef struct {
+    int depth;
+    uint64_t maxNodes;  // 0 means no limit
+    int noise;          // up to this many random centipawns are added to every root move
+    uint64_t seed;
+} SearchConfig;
+
+typedef struct {
+    bool hasMove;
+    Step best;
+    int score;  // centipawns from the side to move's view
+    int depth;  // the last finished iteration
+    uint64_t nodes;
+} SearchResult;
+
+// iterative deepening alpha-beta, the endgame tablebases are probed when registered
+void Search_run(const GameState* game, const SearchConfig* cfg, SearchResult* res);
+int Search_eval(const GameState* game);
@@ -0,0 +1,164 @@
+#include "shmring.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SHMRING_MAGIC 0x676e697268736d63ull  // "cmshring"
+#define SHMRING_LAYOUT 1
+// a writer that stays this long inside a slot is taken as dead
+#define SHMRING_RETRIES 4096
+
+// seq is odd while the writer is inside the slot, a slot is one or more cache lines of its own
+typedef struct {
+    uint64_t seq;
+    ShmPosition pos;
+} __attribute__((aligned(64))) Slot;
+
+struct ShmRingHeader {
+    uint64_t magic;  // written last, a reader never sees a half made ring
+    uint32_t layout;
+    uint32_t slots;
+    uint64_t head __attribute__((aligned(64)));  // publishes so far, the newest is in slot (head - 1) % slots
+    Slot ring[];
+};
+
+_Static_assert(sizeof(ShmPosition) % sizeof(uint64_t) == 0, "positions are copied in words");
+
+static const char piece_letters[] = { [King] = 'K', [Queen] = 'Q', [Rook] = 'R',
+                                      [Bishop] = 'B', [Knight] = 'N', [Pawn] = 'P' };
+
+// the words are atomic so the copy racing with the writer is defined, the seq check throws a torn copy away
+static void copy_words(uint64_t* dst, const uint64_t* src, bool store) {
+    for (size_t i = 0; i < sizeof(ShmPosition) / sizeof(uint64_t); i++) {
+        if (store) {
+            __atomic_store_n(&dst[i], src[i], __ATOMIC_RELAXED);
+        } else {
+            dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+int ShmRing_create(ShmRing* ring, const char* name, int slots) {
+    memset(ring, 0, sizeof(*ring));
+    if (slots < 1 || snprintf(ring->name, sizeof(ring->name), "%s", name) >= (int) sizeof(ring->name)) return -1;
+    ring->size = sizeof(ShmRingHeader) + sizeof(Slot) * slots;
+    ring->writer = true;
+
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) return -1;
+    // the new pages are zero, every slot starts with an even seq
+    if (ftruncate(fd, ring->size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    void* p = mmap(NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(name);
+        return -1;
+    }
+    ring->hdr = p;
+    ring->hdr->layout = SHMRING_LAYOUT;
+    ring->hdr->slots = slots;
+    __atomic_store_n(&ring->hdr->magic, SHMRING_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int ShmRing_open(ShmRing* ring, const char* name) {
+    memset(ring, 0, sizeof(*ring));
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(ShmRingHeader)) {
+        close(fd);
+        return -1;
+    }
+    // read only, a reader cannot disturb the writer or the other readers
+    void* p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return -1;
+    ring->hdr = p;
+    ring->size = st.st_size;
+    snprintf(ring->name, sizeof(ring->name), "%s", name);
+    if (__atomic_load_n(&ring->hdr->magic, __ATOMIC_ACQUIRE) != SHMRING_MAGIC ||
+        ring->hdr->layout != SHMRING_LAYOUT || ring->hdr->slots == 0 ||
+        sizeof(ShmRingHeader) + sizeof(Slot) * ring->hdr->slots > ring->size) {
+        ShmRing_close(ring);
+        return -1;
+    }
+    return 0;
+}
+
+void ShmRing_close(ShmRing* ring) {
+    if (ring->hdr != NULL) munmap(ring->hdr, ring->size);
+    if (ring->writer) shm_unlink(ring->name);
+    ring->hdr = NULL;
+}
+
+void ShmRing_publish(ShmRing* ring, const GameState* game) {
+    ShmPosition pos;
+    memset(&pos, 0, sizeof(pos));
+    ShmRingHeader* hdr = ring->hdr;
+    uint64_t head = hdr->head;
+    pos.version = head;
+    pos.ply = game->stepNum;
+    pos.turn = game->turn;
+    pos.isFinished = game->isFinished;
+    pos.winner = game->winner;
+    for (int i = 0; i < 64; i++) {
+        const Elem* e = &game->board[i];
+        pos.board[i] = e->isEmpty ? '.' : piece_letters[e->piece] | (e->team == Black ? 0x20 : 0);
+    }
+    int end = game->stepNum < MAXSTEPS ? game->stepNum : MAXSTEPS;
+    int begin = end > SHMRING_MOVES ? end - SHMRING_MOVES : 0;
+    pos.moveNum = end - begin;
+    for (int i = begin; i < end; i++) {
+        char move[5];
+        Step_tostr(&game->history[i], move);
+        memcpy(pos.moves[i - begin], move, 4);
+    }
+
+    // odd seq, the words, even seq, and only then the new head
+    Slot* slot = &hdr->ring[head % hdr->slots];
+    uint64_t seq = slot->seq;
+    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    copy_words((uint64_t*) &slot->pos, (const uint64_t*) &pos, true);
+    __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&hdr->head, head + 1, __ATOMIC_RELEASE);
+}
+
+uint64_t ShmRing_version(const ShmRing* ring) {
+    return __atomic_load_n(&ring->hdr->head, __ATOMIC_ACQUIRE);
+}
+
+bool ShmRing_get(const ShmRing* ring, uint64_t version, ShmPosition* pos) {
+    const ShmRingHeader* hdr = ring->hdr;
+    if (version >= ShmRing_version(ring)) return false;
+    const Slot* slot = &hdr->ring[version % hdr->slots];
+    for (int i = 0; i < SHMRING_RETRIES; i++) {
+        uint64_t before = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (before & 1) continue;
+        copy_words((uint64_t*) pos, (const uint64_t*) &slot->pos, false);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != before) continue;
+        // a consistent copy of a later lap means the version is gone
+        return pos->version == version;
+    }
+    return false;
+}
+
+bool ShmRing_latest(const ShmRing* ring, ShmPosition* pos) {
+    for (int i = 0; i < SHMRING_RETRIES; i++) {
+        uint64_t head = ShmRing_version(ring);
+        if (head == 0) return false;
+        // the writer may lap the slot while it is read, the newer head is tried then
+        if (ShmRing_get(ring, head - 1, pos)) return true;
+    }
+    return false;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "chess.h"
+
+// the last moves kept with every published position
+#define SHMRING_MOVES 16
+
+// what a reader gets, a copy taken while no write was in progress
+typedef struct {
+    uint64_t version;  // publishes before this one
+    int32_t ply;
+    int8_t turn;
+    int8_t isFinished;
+    int8_t winner;
+    int8_t moveNum;
+    char board[64];                 // board[x + 8 * y], FEN letters and '.' for an empty square
+    char moves[SHMRING_MOVES][4];  // "e2e4" without a terminator, the oldest first
+} ShmPosition;
+
+typedef struct ShmRingHeader ShmRingHeader;
+
+// one writer process publishes, any number of processes map the ring read only and never call into the kernel
+typedef struct {
+    ShmRingHeader* hdr;
+    size_t size;
+    bool writer;
+    char name[64];
+} ShmRing;
+
+// the name is a POSIX shared memory name like "/minichess", an old ring of the name is replaced
+int ShmRing_create(ShmRing* ring, const char* name, int slots);
+int ShmRing_open(ShmRing* ring, const char* name);
+// the writer unmaps and removes the name, readers only unmap
+void ShmRing_close(ShmRing* ring);
+
+// never waits for readers, a reader that is too slow finds its slot overwritten
+void ShmRing_publish(ShmRing* ring, const GameState* game);
+// the number of publishes so far
+uint64_t ShmRing_version(const ShmRing* ring);
+// false when the version was overwritten, is not published yet or the writer died inside the slot
+bool ShmRing_get(const ShmRing* ring, uint64_t version, ShmPosition* pos);
+bool ShmRing_latest(const ShmRing* ring, ShmPosition* pos);
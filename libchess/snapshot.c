@@ -0,0 +1,198 @@
+#include "snapshot.h"
+#include <stdbool.h>
+#include <string.h>
+
+static const char piece_letters[] = { [King] = 'K', [Queen] = 'Q', [Rook] = 'R',
+                                      [Bishop] = 'B', [Knight] = 'N', [Pawn] = 'P' };
+static const char* const team_names[] = { [White] = "white", [Black] = "black", [NoTeam] = "none" };
+
+static int piece_decode(char c, Piece* p) {
+    for (int i = 0; i < 6; i++) {
+        if (piece_letters[i] == (c & ~0x20)) {
+            *p = i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int team_decode(const JsonBaseObj* v, Team* t) {
+    if (v == NULL || v->type != JStr) return -1;
+    for (int i = 0; i < 3; i++) {
+        int len = strlen(team_names[i]);
+        if (v->jsonStr.len == len && memcmp(v->jsonStr.data, team_names[i], len) == 0) {
+            *t = i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// "Pe2e4", "Qd1d8xr#"
+static int step_encode(const Step* step, char buf[8]) {
+    int n = 0;
+    buf[n++] = piece_letters[step->p] | (step->turn == Black ? 0x20 : 0);
+    buf[n++] = 'a' + step->from.x;
+    buf[n++] = '1' + step->from.y;
+    buf[n++] = 'a' + step->to.x;
+    buf[n++] = '1' + step->to.y;
+    if (step->isEat) {
+        buf[n++] = 'x';
+        buf[n++] = piece_letters[step->died] | (step->turn == White ? 0x20 : 0);
+    }
+    if (step->isCheckMate) buf[n++] = '#';
+    return n;
+}
+
+static int step_decode(const JsonBaseObj* v, Step* step) {
+    if (v->type != JStr || v->jsonStr.cap == JSTR_ESCAPED) return -1;
+    const char* s = v->jsonStr.data;
+    int len = v->jsonStr.len;
+    *step = (Step){ 0 };
+    if (len < 5 || piece_decode(s[0], &step->p) != 0) return -1;
+    step->turn = s[0] & 0x20 ? Black : White;
+    for (int i = 1; i < 5; i += 2) {
+        if (s[i] < 'a' || s[i] > 'h' || s[i + 1] < '1' || s[i + 1] > '8') return -1;
+    }
+    step->from = (Vec2){ s[1] - 'a', s[2] - '1' };
+    step->to = (Vec2){ s[3] - 'a', s[4] - '1' };
+
+    int n = 5;
+    if (n + 1 < len && s[n] == 'x') {
+        // the taken piece is of the other color
+        if (piece_decode(s[n + 1], &step->died) != 0 || (s[n + 1] & 0x20) == (s[0] & 0x20)) return -1;
+        step->isEat = true;
+        n += 2;
+    }
+    if (n < len && s[n] == '#') {
+        step->isCheckMate = true;
+        n++;
+    }
+    return n == len ? 0 : -1;
+}
+
+static const JsonBaseObj* field(const JsonBaseObj* obj, const char* key, JsonObjType type) {
+    const JsonBaseObj* v = minijson_map_get(&obj->jsonMap, key, strlen(key));
+    return v != NULL && v->type == type ? v : NULL;
+}
+
+// the fields a snapshot and a delta share, the caller has opened the object
+static void write_common(const GameState* game, int since, JsonWriter* w) {
+    jwriter_key(w, "ply", 3);
+    jwriter_int(w, game->stepNum);
+    jwriter_key(w, "turn", 4);
+    jwriter_str(w, team_names[game->turn], strlen(team_names[game->turn]));
+    jwriter_key(w, "finished", 8);
+    jwriter_bool(w, game->isFinished);
+    jwriter_key(w, "winner", 6);
+    jwriter_str(w, team_names[game->winner], strlen(team_names[game->winner]));
+
+    char move[8];
+    int end = game->stepNum < MAXSTEPS ? game->stepNum : MAXSTEPS;
+    jwriter_key(w, "moves", 5);
+    jwriter_begin_array(w);
+    for (int i = since; i < end; i++) {
+        jwriter_str(w, move, step_encode(&game->history[i], move));
+    }
+    jwriter_end_array(w);
+}
+
+int Snapshot_write(const GameState* game, JsonWriter* w) {
+    char fen[100];
+    jwriter_begin_object(w);
+    write_common(game, 0, w);
+    jwriter_key(w, "fen", 3);
+    jwriter_str(w, fen, Game_toFen(game, fen, sizeof(fen)));
+    jwriter_end_object(w);
+    return w->failed ? -1 : 0;
+}
+
+int Snapshot_writeDelta(const GameState* game, int since, JsonWriter* w) {
+    if (since < 0 || since > game->stepNum) return -1;
+    jwriter_begin_object(w);
+    jwriter_key(w, "since", 5);
+    jwriter_int(w, since);
+    write_common(game, since, w);
+    jwriter_end_object(w);
+    return w->failed ? -1 : 0;
+}
+
+typedef struct {
+    int ply;
+    Team turn;
+    bool isFinished;
+    Team winner;
+    const JsonArray* moves;
+} Header;
+
+static int read_common(const JsonBaseObj* obj, Header* h) {
+    if (obj->type != JMap) return -1;
+    const JsonBaseObj* ply = field(obj, "ply", JNum);
+    const JsonBaseObj* finished = field(obj, "finished", JBool);
+    const JsonBaseObj* moves = field(obj, "moves", JArray);
+    if (ply == NULL || !ply->jsonNum.isInt || finished == NULL || moves == NULL) return -1;
+    if (team_decode(field(obj, "turn", JStr), &h->turn) != 0 || h->turn == NoTeam) return -1;
+    if (team_decode(field(obj, "winner", JStr), &h->winner) != 0) return -1;
+    if (ply->jsonNum.Int64 < 0 || ply->jsonNum.Int64 > MAXSTEPS) return -1;
+    h->ply = ply->jsonNum.Int64;
+    h->isFinished = finished->jsonBool.data;
+    h->moves = &moves->jsonArray;
+    return 0;
+}
+
+int Snapshot_restore(GameState* game, const JsonBaseObj* snap) {
+    Header h;
+    if (read_common(snap, &h) != 0 || h.moves->length != h.ply) return -1;
+
+    const JsonBaseObj* fen = field(snap, "fen", JStr);
+    char buf[100];
+    if (fen == NULL || fen->jsonStr.cap == JSTR_ESCAPED || fen->jsonStr.len >= (int) sizeof(buf)) return -1;
+    memcpy(buf, fen->jsonStr.data, fen->jsonStr.len);
+    buf[fen->jsonStr.len] = '\0';
+    // built on a copy, a bad snapshot leaves the game as it was
+    GameState tmp;
+    if (Game_fromFen(&tmp, buf) != 0 || tmp.turn != h.turn) return -1;
+
+    for (int i = 0; i < h.ply; i++) {
+        if (step_decode(&h.moves->list[i], &tmp.history[i]) != 0) return -1;
+    }
+    tmp.stepNum = h.ply;
+    tmp.isFinished = h.isFinished;
+    tmp.winner = h.winner;
+    *game = tmp;
+    return 0;
+}
+
+int Snapshot_applyDelta(GameState* game, const JsonBaseObj* delta) {
+    Header h;
+    if (read_common(delta, &h) != 0) return -1;
+    const JsonBaseObj* since = field(delta, "since", JNum);
+    if (since == NULL || !since->jsonNum.isInt || since->jsonNum.Int64 != game->stepNum) return -1;
+    if (h.moves->length != h.ply - game->stepNum) return -1;
+
+    // every move is checked on a copy of the board first, a bad delta leaves the game as it was
+    Elem board[64];
+    memcpy(board, game->board, sizeof(board));
+    Team turn = game->turn;
+    for (int i = 0; i < h.moves->length; i++) {
+        Step step;
+        if (step_decode(&h.moves->list[i], &step) != 0 || step.turn != turn) return -1;
+        Elem* from = &board[step.from.x + 8 * step.from.y];
+        Elem* to = &board[step.to.x + 8 * step.to.y];
+        if (from->isEmpty || from->team != turn || from->piece != step.p) return -1;
+        if (step.isEat != !to->isEmpty || (step.isEat && (to->team == turn || to->piece != step.died))) return -1;
+        *to = *from;
+        from->isEmpty = true;
+        turn = turn == White ? Black : White;
+    }
+    if (turn != h.turn) return -1;
+
+    for (int i = 0; i < h.moves->length; i++) {
+        Step* step = &game->history[game->stepNum];
+        step_decode(&h.moves->list[i], step);
+        Game_doStep(game, step);
+    }
+    game->isFinished = h.isFinished;
+    game->winner = h.winner;
+    return 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "chess.h"
+#include "minijson.h"
+
+// a snapshot is one JSON object:
+// {"ply":3,"turn":"black","finished":false,"winner":"none","fen":"...","moves":["Pe2e4","pe7e5","Pd2d4"]}
+// a move is the piece letter, uppercase for white, the squares, "x" and the taken piece on a capture and "#" on mate
+// a delta is {"since":1,"ply":3,...,"moves":[...]} with only the moves from ply `since` on and no fen
+
+int Snapshot_write(const GameState* game, JsonWriter* w);
+int Snapshot_writeDelta(const GameState* game, int since, JsonWriter* w);
+// the board comes from the fen and the history from the moves, nothing is replayed through Game_exec
+int Snapshot_restore(GameState* game, const JsonBaseObj* snap);
+// the game must be at ply `since`, the moves are checked against the board before any is applied
+int Snapshot_applyDelta(GameState* game, const JsonBaseObj* delta);
@@ -0,0 +1,693 @@
+#include "tablebase.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TB_UNKNOWN 0xffff
+#define TB_CHUNK 4096
+#define TB_MAXMOVES 64
+#define TB_MAXTHREADS 64
+#define TB_NOLOSS 0xff
+
+static const char tb_magic[8] = "MCTB001";
+
+static const Tablebase* registry[TB_MAXTABLES];
+static int registryNum = 0;
+
+// squares a piece could reach on an empty board, a superset of what the piece rules accept
+static int8_t reach[6][64][28];
+static int reachNum[6][64];
+static pthread_once_t reachOnce = PTHREAD_ONCE_INIT;
+
+// the generation context shared by all worker threads of one pass
+typedef struct {
+    Tablebase* tb;
+    Tablebase* sub[TB_MAXPIECES];  // the table after piece i is captured, NULL means bare kings
+    uint64_t perms;
+    uint16_t* work;    // value | dtm << 2, TB_UNKNOWN while not resolved
+    uint8_t* moves;    // moves inside this table whose child is not yet known to be a win
+    uint8_t* lossMin;  // the least dtm of a loss through the captures, TB_NOLOSS if a capture draws
+    int pass;
+    uint64_t next;
+    uint64_t changed;
+    int maxDtm;
+} TbGen;
+
+typedef struct {
+    int sq[TB_MAXPIECES];
+    Team turn;
+} TbPos;
+
+static int piece_from_char(char c, Piece* p) {
+    switch (c) {
+    case 'K':
+        *p = King;
+        return 0;
+    case 'Q':
+        *p = Queen;
+        return 0;
+    case 'R':
+        *p = Rook;
+        return 0;
+    case 'B':
+        *p = Bishop;
+        return 0;
+    case 'N':
+        *p = Knight;
+        return 0;
+    case 'P':
+        *p = Pawn;
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+static const char piece_chars[] = {
+    [King] = 'K', [Queen] = 'Q', [Rook] = 'R', [Bishop] = 'B', [Knight] = 'N', [Pawn] = 'P',
+};
+
+// normalize a material string like "KRQK" to "KQRK", the strong pieces are ordered by Piece
+static int parse_material(Tablebase* tb, const char* material) {
+    int len = strlen(material);
+    if (len < 3 || len > TB_MAXPIECES || material[0] != 'K' || material[len - 1] != 'K') return -1;
+
+    Piece extra[TB_MAXPIECES];
+    int extraNum = 0;
+    for (int i = 1; i < len - 1; i++) {
+        Piece p;
+        if (piece_from_char(material[i], &p) != 0 || p == King) return -1;
+        int j = extraNum++;
+        for (; j > 0 && extra[j - 1] > p; j--) {
+            extra[j] = extra[j - 1];
+        }
+        extra[j] = p;
+    }
+
+    tb->pieceNum = len;
+    tb->pieces[0] = King;
+    for (int i = 0; i < extraNum; i++) {
+        tb->pieces[i + 1] = extra[i];
+    }
+    tb->pieces[len - 1] = King;
+    for (int i = 0; i < len; i++) {
+        tb->material[i] = piece_chars[tb->pieces[i]];
+    }
+    tb->material[len] = '\0';
+
+    uint64_t perms = 1;
+    for (int i = 0; i < len; i++) {
+        perms *= 64 - i;
+    }
+    tb->size = perms * 2;
+    return 0;
+}
+
+static Team piece_team(const Tablebase* tb, int i) {
+    return i == tb->pieceNum - 1 ? Black : White;
+}
+
+static int king_index(const Tablebase* tb, Team t) {
+    return t == White ? 0 : tb->pieceNum - 1;
+}
+
+// rank the placement as a permutation of distinct squares
+static uint64_t perm_rank(const int sq[], int n) {
+    uint64_t idx = 0;
+    for (int i = 0; i < n; i++) {
+        int r = sq[i];
+        for (int j = 0; j < i; j++) {
+            if (sq[j] < sq[i]) r--;
+        }
+        idx = idx * (64 - i) + r;
+    }
+    return idx;
+}
+
+static void perm_unrank(uint64_t idx, int sq[], int n) {
+    int digits[TB_MAXPIECES];
+    for (int i = n - 1; i >= 0; i--) {
+        digits[i] = idx % (64 - i);
+        idx /= 64 - i;
+    }
+
+    int used[TB_MAXPIECES];  // sorted squares placed so far
+    for (int i = 0; i < n; i++) {
+        int s = digits[i];
+        int j = 0;
+        for (; j < i && used[j] <= s; j++) {
+            s++;
+        }
+        sq[i] = s;
+        for (int k = i; k > j; k--) {
+            used[k] = used[k - 1];
+        }
+        used[j] = s;
+    }
+}
+
+static uint64_t pos_index(const Tablebase* tb, const TbPos* pos) {
+    uint64_t perms = tb->size / 2;
+    return (pos->turn == White ? 0 : perms) + perm_rank(pos->sq, tb->pieceNum);
+}
+
+static Vec2 sq_vec(int sq) {
+    Vec2 v = { .x = sq % 8, .y = sq / 8 };
+    return v;
+}
+
+static void set_board(GameState* game, const Tablebase* tb, const TbPos* pos) {
+    for (int i = 0; i < 64; i++) {
+        game->board[i].isEmpty = true;
+    }
+    for (int i = 0; i < tb->pieceNum; i++) {
+        Elem* e = &game->board[pos->sq[i]];
+        e->isEmpty = false;
+        e->team = piece_team(tb, i);
+        e->piece = tb->pieces[i];
+    }
+    game->turn = pos->turn;
+}
+
+// whether a piece of team `by` can move onto target, the captured piece `skip` is ignored
+static bool attacked(const GameState* game, const Tablebase* tb, const int sq[], int target, Team by, int skip) {
+    for (int i = 0; i < tb->pieceNum; i++) {
+        if (i == skip || piece_team(tb, i) != by) continue;
+        Step step = { .from = sq_vec(sq[i]), .to = sq_vec(target) };
+        if (Game_checkPieceRule(game, &step) == Success) return true;
+    }
+    return false;
+}
+
+static void add_reach(Piece p, int from, const int dirs[][2], int dirNum, bool slide) {
+    for (int d = 0; d < dirNum; d++) {
+        int x = from % 8 + dirs[d][0];
+        int y = from / 8 + dirs[d][1];
+        for (; x >= 0 && x < 8 && y >= 0 && y < 8; x += dirs[d][0], y += dirs[d][1]) {
+            reach[p][from][reachNum[p][from]++] = x + 8 * y;
+            if (!slide) break;
+        }
+    }
+}
+
+static void init_reach() {
+    static const int kingDirs[8][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 },
+                                        { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+    static const int knightDirs[8][2] = { { 1, 2 },  { 2, 1 },  { -1, 2 }, { -2, 1 },
+                                          { 1, -2 }, { 2, -1 }, { -1, -2 }, { -2, -1 } };
+    static const int pawnDirs[4][2] = { { 0, 1 }, { 0, 2 }, { 0, -1 }, { 0, -2 } };
+
+    for (int from = 0; from < 64; from++) {
+        add_reach(King, from, kingDirs, 8, false);
+        add_reach(Queen, from, kingDirs, 8, true);
+        add_reach(Rook, from, kingDirs, 4, true);
+        add_reach(Bishop, from, kingDirs + 4, 4, true);
+        add_reach(Knight, from, knightDirs, 8, false);
+        add_reach(Pawn, from, pawnDirs, 4, false);
+    }
+}
+
+static uint64_t entry_get(const uint64_t* data, int bits, uint64_t idx) {
+    uint64_t bitpos = idx * bits;
+    uint64_t w = bitpos >> 6;
+    int off = bitpos & 63;
+    uint64_t v = data[w] >> off;
+    if (off + bits > 64) v |= data[w + 1] << (64 - off);
+    return v & ((1ull << bits) - 1);
+}
+
+static void entry_set(uint64_t* data, int bits, uint64_t idx, uint64_t v) {
+    uint64_t bitpos = idx * bits;
+    uint64_t w = bitpos >> 6;
+    int off = bitpos & 63;
+    data[w] |= v << off;
+    if (off + bits > 64) data[w + 1] |= v >> (64 - off);
+}
+
+static uint64_t data_words(const Tablebase* tb) {
+    return (tb->size * tb->entryBits + 63) / 64 + 1;
+}
+
+TbResult Tablebase_get(const Tablebase* tb, uint64_t index) {
+    uint64_t v = entry_get(tb->data, tb->entryBits, index);
+    TbResult res = { .value = v & 3, .dtm = v >> 2 };
+    return res;
+}
+
+static TbResult sub_result(const TbGen* gen, const TbPos* child, int captured) {
+    const Tablebase* sub = gen->sub[captured];
+    if (sub == NULL) {
+        TbResult draw = { .value = TbDraw, .dtm = 0 };
+        return draw;
+    }
+    TbPos subPos = { .turn = child->turn };
+    int n = 0;
+    for (int i = 0; i < gen->tb->pieceNum; i++) {
+        if (i != captured) subPos.sq[n++] = child->sq[i];
+    }
+    return Tablebase_get(sub, pos_index(sub, &subPos));
+}
+
+// enumerate the legal moves of pos, returns the move number and fills the child positions
+static int gen_children(const TbGen* gen, GameState* game, const TbPos* pos, TbPos children[], int captured[]) {
+    const Tablebase* tb = gen->tb;
+    Team other = pos->turn == White ? Black : White;
+    int kingIdx = king_index(tb, pos->turn);
+    int num = 0;
+
+    for (int i = 0; i < tb->pieceNum; i++) {
+        if (piece_team(tb, i) != pos->turn) continue;
+        int from = pos->sq[i];
+        Piece p = tb->pieces[i];
+        for (int k = 0; k < reachNum[p][from]; k++) {
+            int to = reach[p][from][k];
+            Elem* toElem = &game->board[to];
+            if (!toElem->isEmpty && toElem->team == pos->turn) continue;
+            Step step = { .from = sq_vec(from), .to = sq_vec(to) };
+            if (Game_checkPieceRule(game, &step) != Success) continue;
+
+            int cap = -1;
+            for (int j = 0; j < tb->pieceNum; j++) {
+                if (pos->sq[j] == to) cap = j;
+            }
+
+            TbPos* child = &children[num];
+            *child = *pos;
+            child->sq[i] = to;
+            child->turn = other;
+
+            Elem saved = *toElem;
+            *toElem = game->board[from];
+            game->board[from].isEmpty = true;
+            bool legal = !attacked(game, tb, child->sq, child->sq[kingIdx], other, cap);
+            game->board[from] = *toElem;
+            *toElem = saved;
+
+            if (legal) {
+                captured[num] = cap;
+                num++;
+            }
+        }
+    }
+    return num;
+}
+
+// enumerate the positions reaching pos by a move without capture
+static int gen_parents(const TbGen* gen, GameState* game, const TbPos* pos, TbPos parents[]) {
+    const Tablebase* tb = gen->tb;
+    Team mover = pos->turn == White ? Black : White;
+    int kingIdx = king_index(tb, pos->turn);
+    int num = 0;
+
+    for (int i = 0; i < tb->pieceNum; i++) {
+        if (piece_team(tb, i) != mover) continue;
+        int to = pos->sq[i];
+        Piece p = tb->pieces[i];
+        for (int k = 0; k < reachNum[p][to]; k++) {
+            int from = reach[p][to][k];
+            if (!game->board[from].isEmpty) continue;
+
+            TbPos* parent = &parents[num];
+            *parent = *pos;
+            parent->sq[i] = from;
+            parent->turn = mover;
+
+            game->board[from] = game->board[to];
+            game->board[to].isEmpty = true;
+            Step step = { .from = sq_vec(from), .to = sq_vec(to) };
+            bool legal = Game_checkPieceRule(game, &step) == Success &&
+                         !attacked(game, tb, parent->sq, parent->sq[kingIdx], mover, -1);
+            game->board[to] = game->board[from];
+            game->board[from].isEmpty = true;
+
+            if (legal) num++;
+        }
+    }
+    return num;
+}
+
+// set the entry unless it is already resolved with a faster result
+static bool gen_resolve(TbGen* gen, uint64_t idx, TbValue value, int dtm) {
+    uint16_t e = __atomic_load_n(&gen->work[idx], __ATOMIC_RELAXED);
+    uint16_t want = value | dtm << 2;
+    while (e == TB_UNKNOWN || ((e & 3) == value && value == TbWin && (e >> 2) > dtm)) {
+        if (__atomic_compare_exchange_n(&gen->work[idx], &e, want, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            int cur = __atomic_load_n(&gen->maxDtm, __ATOMIC_RELAXED);
+            while (dtm > cur && !__atomic_compare_exchange_n(&gen->maxDtm, &cur, dtm, false, __ATOMIC_RELAXED,
+                                                             __ATOMIC_RELAXED))
+                ;
+            return true;
+        }
+    }
+    return false;
+}
+
+// count the moves of every position, solve mates, stalemates and the results through captures
+static uint64_t gen_init(TbGen* gen, GameState* game, uint64_t idx) {
+    const Tablebase* tb = gen->tb;
+    TbPos pos = { .turn = idx < gen->perms ? White : Black };
+    perm_unrank(idx % gen->perms, pos.sq, tb->pieceNum);
+    Team other = pos.turn == White ? Black : White;
+    set_board(game, tb, &pos);
+
+    // the side not to move must not be in check
+    if (attacked(game, tb, pos.sq, pos.sq[king_index(tb, other)], pos.turn, -1)) {
+        gen->work[idx] = TbIllegal;
+        return 0;
+    }
+
+    TbPos children[TB_MAXMOVES];
+    int captured[TB_MAXMOVES];
+    int num = gen_children(gen, game, &pos, children, captured);
+    if (num == 0) {
+        bool check = attacked(game, tb, pos.sq, pos.sq[king_index(tb, pos.turn)], other, -1);
+        gen->work[idx] = check ? TbLoss : TbDraw;
+        return 1;
+    }
+
+    int moves = 0;
+    int winDtm = -1;
+    int lossMin = 0;
+    for (int i = 0; i < num; i++) {
+        if (captured[i] < 0) {
+            moves++;
+            continue;
+        }
+        TbResult res = sub_result(gen, &children[i], captured[i]);
+        if (res.value == TbLoss && (winDtm < 0 || res.dtm + 1 < winDtm)) winDtm = res.dtm + 1;
+        if (res.value == TbWin && res.dtm + 1 > lossMin && lossMin != TB_NOLOSS) lossMin = res.dtm + 1;
+        if (res.value == TbDraw) lossMin = TB_NOLOSS;
+    }
+
+    gen->work[idx] = TB_UNKNOWN;
+    gen->moves[idx] = moves;
+    gen->lossMin[idx] = lossMin;
+    if (winDtm >= 0) return gen_resolve(gen, idx, TbWin, winDtm);
+    if (moves == 0 && lossMin != TB_NOLOSS) return gen_resolve(gen, idx, TbLoss, lossMin);
+    return 0;
+}
+
+// pass n spreads the positions solved with dtm n - 1 to their parents
+static uint64_t gen_step(TbGen* gen, GameState* game, uint64_t idx) {
+    const Tablebase* tb = gen->tb;
+    uint16_t e = __atomic_load_n(&gen->work[idx], __ATOMIC_RELAXED);
+    if (e == TB_UNKNOWN || (e >> 2) != gen->pass - 1) return 0;
+    TbValue value = e & 3;
+    if (value != TbWin && value != TbLoss) return 0;
+
+    TbPos pos = { .turn = idx < gen->perms ? White : Black };
+    perm_unrank(idx % gen->perms, pos.sq, tb->pieceNum);
+    set_board(game, tb, &pos);
+
+    TbPos parents[TB_MAXMOVES];
+    int num = gen_parents(gen, game, &pos, parents);
+    uint64_t changed = 0;
+    for (int i = 0; i < num; i++) {
+        uint64_t p = pos_index(tb, &parents[i]);
+        if (value == TbLoss) {
+            changed += gen_resolve(gen, p, TbWin, gen->pass);
+        } else if (__atomic_sub_fetch(&gen->moves[p], 1, __ATOMIC_RELAXED) == 0 && gen->lossMin[p] != TB_NOLOSS) {
+            int dtm = gen->lossMin[p] > gen->pass ? gen->lossMin[p] : gen->pass;
+            changed += gen_resolve(gen, p, TbLoss, dtm);
+        }
+    }
+    return changed;
+}
+
+static void* gen_worker(void* arg) {
+    TbGen* gen = arg;
+    GameState* game = malloc(sizeof(GameState));
+    uint64_t changed = 0;
+
+    while (1) {
+        uint64_t begin = __atomic_fetch_add(&gen->next, TB_CHUNK, __ATOMIC_RELAXED);
+        if (begin >= gen->tb->size) break;
+        uint64_t end = begin + TB_CHUNK < gen->tb->size ? begin + TB_CHUNK : gen->tb->size;
+
+        for (uint64_t idx = begin; idx < end; idx++) {
+            changed += gen->pass == 0 ? gen_init(gen, game, idx) : gen_step(gen, game, idx);
+        }
+    }
+
+    __atomic_fetch_add(&gen->changed, changed, __ATOMIC_RELAXED);
+    free(game);
+    return NULL;
+}
+
+static void gen_pass(TbGen* gen, int threads) {
+    gen->next = 0;
+    gen->changed = 0;
+    if (threads <= 1) {
+        gen_worker(gen);
+        return;
+    }
+
+    pthread_t tids[TB_MAXTHREADS];
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&tids[i], NULL, gen_worker, gen);
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+}
+
+static int gen_pack(TbGen* gen) {
+    Tablebase* tb = gen->tb;
+    int maxDtm = 0;
+    for (uint64_t i = 0; i < tb->size; i++) {
+        if (gen->work[i] == TB_UNKNOWN) gen->work[i] = TbDraw;
+        if ((gen->work[i] >> 2) > maxDtm) maxDtm = gen->work[i] >> 2;
+    }
+
+    int dtmBits = 0;
+    while ((1 << dtmBits) <= maxDtm) {
+        dtmBits++;
+    }
+    tb->maxDtm = maxDtm;
+    tb->entryBits = 2 + dtmBits;
+    tb->data = calloc(data_words(tb), sizeof(uint64_t));
+    if (tb->data == NULL) return -1;
+
+    for (uint64_t i = 0; i < tb->size; i++) {
+        entry_set(tb->data, tb->entryBits, i, gen->work[i]);
+    }
+    return 0;
+}
+
+int Tablebase_generate(Tablebase* tb, const char* material, int threads) {
+    memset(tb, 0, sizeof(Tablebase));
+    if (parse_material(tb, material) != 0) return -1;
+    pthread_once(&reachOnce, init_reach);
+    if (threads > TB_MAXTHREADS) threads = TB_MAXTHREADS;
+
+    TbGen gen = { .tb = tb, .perms = tb->size / 2 };
+    int ret = -1;
+
+    // capturing a strong piece leaves a smaller table of the same kind
+    for (int i = 1; i < tb->pieceNum - 1; i++) {
+        if (tb->pieceNum == 3) break;
+        char subMaterial[TB_MAXPIECES + 1];
+        int n = 0;
+        for (int j = 0; j < tb->pieceNum; j++) {
+            if (j != i) subMaterial[n++] = tb->material[j];
+        }
+        subMaterial[n] = '\0';
+
+        gen.sub[i] = malloc(sizeof(Tablebase));
+        if (gen.sub[i] == NULL || Tablebase_generate(gen.sub[i], subMaterial, threads) != 0) goto finish;
+    }
+
+    gen.work = malloc(tb->size * sizeof(uint16_t));
+    gen.moves = malloc(tb->size);
+    gen.lossMin = malloc(tb->size);
+    if (gen.work == NULL || gen.moves == NULL || gen.lossMin == NULL) goto finish;
+
+    // every pass only visits the positions solved by the last one
+    for (gen.pass = 0; gen.pass <= gen.maxDtm + 1; gen.pass++) {
+        gen_pass(&gen, threads);
+        if (gen.maxDtm >= TB_UNKNOWN >> 2) goto finish;
+    }
+
+    ret = gen_pack(&gen);
+
+finish:
+    free(gen.work);
+    free(gen.moves);
+    free(gen.lossMin);
+    for (int i = 0; i < TB_MAXPIECES; i++) {
+        if (gen.sub[i] == NULL) continue;
+        Tablebase_free(gen.sub[i]);
+        free(gen.sub[i]);
+    }
+    return ret;
+}
+
+int Tablebase_save(const Tablebase* tb, const char* path) {
+    FILE* f = fopen(path, "wb");
+    if (f == NULL) return -1;
+
+    char material[8] = { 0 };
+    strcpy(material, tb->material);
+    int32_t header[2] = { tb->entryBits, tb->maxDtm };
+    uint64_t words = data_words(tb);
+
+    int ok = fwrite(tb_magic, sizeof(tb_magic), 1, f) == 1 && fwrite(material, sizeof(material), 1, f) == 1 &&
+             fwrite(header, sizeof(header), 1, f) == 1 && fwrite(tb->data, sizeof(uint64_t), words, f) == words;
+    if (fclose(f) != 0) ok = 0;
+    return ok ? 0 : -1;
+}
+
+int Tablebase_load(Tablebase* tb, const char* path) {
+    memset(tb, 0, sizeof(Tablebase));
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) return -1;
+
+    char magic[8];
+    char material[8];
+    int32_t header[2];
+    if (fread(magic, sizeof(magic), 1, f) != 1 || memcmp(magic, tb_magic, sizeof(magic)) != 0) goto fail;
+    if (fread(material, sizeof(material), 1, f) != 1 || fread(header, sizeof(header), 1, f) != 1) goto fail;
+    material[7] = '\0';
+    if (parse_material(tb, material) != 0 || strcmp(tb->material, material) != 0) goto fail;
+    if (header[0] < 2 || header[0] > 16) goto fail;
+
+    tb->entryBits = header[0];
+    tb->maxDtm = header[1];
+    uint64_t words = data_words(tb);
+    tb->data = malloc(words * sizeof(uint64_t));
+    if (tb->data == NULL || fread(tb->data, sizeof(uint64_t), words, f) != words) goto fail;
+
+    fclose(f);
+    return 0;
+
+fail:
+    fclose(f);
+    Tablebase_free(tb);
+    return -1;
+}
+
+void Tablebase_free(Tablebase* tb) {
+    free(tb->data);
+    tb->data = NULL;
+}
+
+int Tablebase_register(const Tablebase* tb) {
+    if (registryNum >= TB_MAXTABLES) return -1;
+    registry[registryNum++] = tb;
+    return 0;
+}
+
+void Tablebase_unregisterAll() {
+    registryNum = 0;
+}
+
+bool Tablebase_probe(const GameState* game, TbResult* res) {
+    int sq[2][TB_MAXPIECES];
+    Piece pieces[2][TB_MAXPIECES];
+    int num[2] = { 0, 0 };
+
+    for (int i = 0; i < 64; i++) {
+        const Elem* e = &game->board[i];
+        if (e->isEmpty) continue;
+        if (num[e->team] == TB_MAXPIECES - 1) return false;
+        sq[e->team][num[e->team]] = i;
+        pieces[e->team][num[e->team]] = e->piece;
+        num[e->team]++;
+    }
+
+    if (num[White] == 1 && num[Black] == 1) {
+        res->value = TbDraw;
+        res->dtm = 0;
+        return true;
+    }
+    if (num[White] != 1 && num[Black] != 1) return false;
+
+    // the table is built with white as the strong side, black strong positions are mirrored
+    Team strong = num[White] == 1 ? Black : White;
+    Team weak = strong == White ? Black : White;
+    int flip = strong == White ? 0 : 56;
+
+    Tablebase key;
+    char material[TB_MAXPIECES + 1];
+    int n = 0;
+    for (int i = 0; i < num[strong]; i++) {
+        if (pieces[strong][i] != King) material[n++] = piece_chars[pieces[strong][i]];
+    }
+    material[n] = '\0';
+    char full[TB_MAXPIECES + 2];
+    snprintf(full, sizeof(full), "K%sK", material);
+    if (parse_material(&key, full) != 0) return false;
+
+    const Tablebase* tb = NULL;
+    for (int i = 0; i < registryNum; i++) {
+        if (strcmp(registry[i]->material, key.material) == 0) tb = registry[i];
+    }
+    if (tb == NULL) return false;
+
+    TbPos pos = { .turn = game->turn == strong ? White : Black };
+    bool used[TB_MAXPIECES] = { false };
+    for (int i = 0; i < tb->pieceNum - 1; i++) {
+        for (int j = 0; j < num[strong]; j++) {
+            if (!used[j] && pieces[strong][j] == tb->pieces[i]) {
+                used[j] = true;
+                pos.sq[i] = sq[strong][j] ^ flip;
+                break;
+            }
+        }
+    }
+    pos.sq[tb->pieceNum - 1] = sq[weak][0] ^ flip;
+
+    *res = Tablebase_get(tb, pos_index(tb, &pos));
+    return res->value != TbIllegal;
+}
+
+bool Tablebase_bestStep(const GameState* game, Step* step) {
+    TbResult cur;
+    if (!Tablebase_probe(game, &cur)) return false;
+
+    Step moves[256];
+    int num = Game_legalMoves(game, moves, 256);
+    if (num == 0) return false;
+
+    GameState* child = malloc(sizeof(GameState));
+    memcpy(child, game, sizeof(GameState));
+
+    int best = -1;
+    int bestDtm = 0;
+    for (int i = 0; i < num; i++) {
+        Elem* from = &child->board[moves[i].from.x + 8 * moves[i].from.y];
+        Elem* to = &child->board[moves[i].to.x + 8 * moves[i].to.y];
+        Elem saved = *to;
+        *to = *from;
+        from->isEmpty = true;
+        child->turn = game->turn == White ? Black : White;
+
+        TbResult res;
+        bool found = Tablebase_probe(child, &res);
+
+        *from = *to;
+        *to = saved;
+        child->turn = game->turn;
+        if (!found) continue;
+
+        // win as fast as possible, lose as slow as possible, keep the draw
+        bool better = false;
+        if (cur.value == TbWin) {
+            better = res.value == TbLoss && (best < 0 || res.dtm < bestDtm);
+        } else if (cur.value == TbLoss) {
+            better = res.value == TbWin && (best < 0 || res.dtm > bestDtm);
+        } else {
+            better = best < 0 && res.value == TbDraw;
+        }
+        if (better) {
+            best = i;
+            bestDtm = res.dtm;
+        }
+    }
+
+    free(child);
+    if (best < 0) return false;
+    *step = moves[best];
+    return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "chess.h"
+
+// a table holds the strong side king, up to two more pieces of it and the bare king of the weak side
+#define TB_MAXPIECES 4
+#define TB_MAXTABLES 16
+
+typedef enum TbValue {
+    TbIllegal = 0,
+    TbDraw,
+    TbWin,
+    TbLoss,
+} TbValue;
+
+// value and distance to mate in plies, both from the side to move's view
+typedef struct {
+    TbValue value;
+    int dtm;
+} TbResult;
+
+typedef struct Tablebase {
+    char material[TB_MAXPIECES + 1];  // e.g. "KQK", the strong side first
+    int pieceNum;
+    Piece pieces[TB_MAXPIECES];  // index order: strong king, strong pieces, weak king
+    uint64_t size;               // 2 * 64 * 63 * ... entries, one per side to move and piece permutation
+    int entryBits;               // 2 bits of TbValue plus the bits of dtm
+    int maxDtm;
+    uint64_t* data;  // bit-packed entries
+} Tablebase;
+
+// generate the table by retrograde analysis, tables of smaller material are generated on the way
+int Tablebase_generate(Tablebase* tb, const char* material, int threads);
+int Tablebase_save(const Tablebase* tb, const char* path);
+int Tablebase_load(Tablebase* tb, const char* path);
+void Tablebase_free(Tablebase* tb);
+TbResult Tablebase_get(const Tablebase* tb, uint64_t index);
+
+// probing works on the registered tables, the table must stay alive while registered
+int Tablebase_register(const Tablebase* tb);
+void Tablebase_unregisterAll();
+bool Tablebase_probe(const GameState* game, TbResult* res);
+bool Tablebase_bestStep(const GameState* game, Step* step);
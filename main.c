@@ -1,26 +1,85 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include "chess.h"
+#include "profile.h"
+#include "shmring.h"
+#include "tablebase.h"
+
+static volatile sig_atomic_t dumpProfile = 0;
+
+static void on_sigusr1(int sig) {
+    dumpProfile = 1;
+}
+
+int main(int argc, char** argv) {
+    // -s name publishes every position to a shared memory ring for ./watch and other local viewers
+    ShmRing ring = { 0 };
+    int opt;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        if (opt != 's' || ShmRing_create(&ring, optarg, 64) != 0) {
+            fprintf(stderr, "usage: %s [-s shmname] [table.mctb]...\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // every other argument is a tablebase file made by tbgen
+    static Tablebase tables[TB_MAXTABLES];
+    for (int i = optind; i < argc; i++) {
+        if (i - optind == TB_MAXTABLES || Tablebase_load(&tables[i - optind], argv[i]) != 0 ||
+            Tablebase_register(&tables[i - optind]) != 0) {
+            fprintf(stderr, "load tablebase %s failed\n", argv[i]);
+            if (ring.hdr != NULL) ShmRing_close(&ring);
+            return 1;
+        }
+    }
+
+    // kill -USR1 prints the profile to stderr, no SA_RESTART so the read below is interrupted
+    struct sigaction sa = { .sa_handler = on_sigusr1 };
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, NULL);
 
-int main() {
     GameState game;
     InitGame(&game);
+    if (ring.hdr != NULL) ShmRing_publish(&ring, &game);
     char buffer[100];
+    bool showProfile = false;
 
     Response res = Success;
     while (1) {
         system("clear");
         Game_debug(&game);
         printf("%s\n", Response_tostr(res));
+        if (showProfile) {
+            Prof_dump(stdout);
+            showProfile = false;
+        }
         printf(">>> \n");
 
-        ssize_t bytes_read = read(STDIN_FILENO, buffer, sizeof(buffer) - 1);
+        ssize_t bytes_read;
+        while ((bytes_read = read(STDIN_FILENO, buffer, sizeof(buffer) - 1)) < 0 && errno == EINTR) {
+            if (dumpProfile) {
+                dumpProfile = 0;
+                Prof_dump(stderr);
+            }
+        }
         if (bytes_read < 0) {
             perror("read");
             return 1;
         }
+        if (bytes_read == 0) break;
         buffer[bytes_read] = '\0';
+        if (strncmp(buffer, "prof", 4) == 0) {
+            showProfile = true;
+            continue;
+        }
         res = Game_exec(&game, buffer);
+        if (res == Success && ring.hdr != NULL) ShmRing_publish(&ring, &game);
     }
+    if (ring.hdr != NULL) ShmRing_close(&ring);
+    return 0;
 }
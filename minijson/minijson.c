@@ -1,399 +1,1797 @@
 #include "minijson.h"
+#include <errno.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-const int INIT_JSTR_LEN = 100;
+#include <unistd.h>
+
+#define ARENA_MIN_BLOCK 4096
+#define MAX_DEPTH 512
+// below it a linear scan over the keys beats hashing, minijson.h states the value
+#define MAP_INDEX_MIN 16
+
+struct JsonArenaBlock {
+    JsonArenaBlock* next;
+    size_t cap;
+    size_t used;
+    max_align_t data[];
+};
+
+static JsonArenaBlock* jarena_block(size_t cap) {
+    JsonArenaBlock* b = malloc(sizeof(JsonArenaBlock) + cap);
+    if (b == NULL) return NULL;
+    b->next = NULL;
+    b->cap = cap;
+    b->used = 0;
+    return b;
+}
 
-static bool isEmpty(char c) {
-    switch (c) {
-    case ' ':
-    case '\t':
-    case '\r':
-    case '\n':
-    case '\0':
-        return true;
+void* jarena_alloc(JsonArena* arena, size_t size) {
+    size = (size + 7) & ~(size_t) 7;
+    JsonArenaBlock* b = arena->head;
+    if (b == NULL || b->cap - b->used < size) {
+        // every block is at least twice the last one, so a document takes O(log n) mallocs
+        size_t cap = b == NULL ? ARENA_MIN_BLOCK : b->cap * 2;
+        if (cap < size) cap = size;
+        JsonArenaBlock* nb = jarena_block(cap);
+        if (nb == NULL) return NULL;
+        nb->next = b;
+        arena->head = b = nb;
+    }
+    void* p = (char*) b->data + b->used;
+    b->used += size;
+    return p;
+}
+
+void jarena_free(JsonArena* arena) {
+    JsonArenaBlock* b = arena->head;
+    while (b != NULL) {
+        JsonArenaBlock* next = b->next;
+        free(b);
+        b = next;
+    }
+    arena->head = NULL;
+}
+
+const char* jstr_cstr(const JsonStr* str) {
+    return str->data;
+}
+
+static bool isDigit(char c) {
+    return '0' <= c && c <= '9';
+}
+
+typedef enum {
+    TNum,
+    TStr,
+    TTrue,
+    TFalse,
+    TNUll,
+    TLBrace,
+    TRBrace,
+    TComma,
+    TColon,
+    TLBracket,
+    TRBracket,
+    TEnd,
+    TError,
+} TokenType;
+
+#define TK_ESCAPED 1  // a string holding a backslash
+#define TK_FLOAT 2    // a number with a fraction or an exponent
+
+// a token only points into the source, nothing is copied while lexing
+typedef struct {
+    uint8_t type;
+    uint8_t flags;
+    int offset;
+    int len;
+} Token;
+
+// the tokens of a whole document, made in one pass before parsing
+typedef struct {
+    Token* tokens;
+    int len;
+} Tape;
+
+typedef enum {
+    CBad = 0,
+    CSpace,
+    CStruct,
+    CQuote,
+    CNum,
+    CLit,
+} CharClass;
+
+static const uint8_t char_class[256] = {
+    [' '] = CSpace,  ['\t'] = CSpace,  ['\r'] = CSpace,  ['\n'] = CSpace,  ['{'] = CStruct, ['}'] = CStruct,
+    ['['] = CStruct, [']'] = CStruct,  [':'] = CStruct,  [','] = CStruct,  ['"'] = CQuote,  ['-'] = CNum,
+    ['0'] = CNum,    ['1'] = CNum,     ['2'] = CNum,     ['3'] = CNum,     ['4'] = CNum,    ['5'] = CNum,
+    ['6'] = CNum,    ['7'] = CNum,     ['8'] = CNum,     ['9'] = CNum,     ['t'] = CLit,    ['f'] = CLit,
+    ['n'] = CLit,
+};
+
+static const uint8_t struct_type[256] = {
+    ['{'] = TLBrace, ['}'] = TRBrace, ['['] = TLBracket, [']'] = TRBracket, [':'] = TColon, [','] = TComma,
+};
+
+// -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+static int scan_num(const char* s, int n, int begin, uint8_t* flags) {
+    int i = begin;
+    if (i < n && s[i] == '-') i++;
+    if (i < n && s[i] == '0') {
+        i++;
+    } else if (i < n && isDigit(s[i])) {
+        while (i < n && isDigit(s[i])) i++;
+    } else {
+        return 0;
+    }
+    if (i < n && s[i] == '.') {
+        *flags |= TK_FLOAT;
+        i++;
+        if (i >= n || !isDigit(s[i])) return 0;
+        while (i < n && isDigit(s[i])) i++;
+    }
+    if (i < n && (s[i] == 'e' || s[i] == 'E')) {
+        *flags |= TK_FLOAT;
+        i++;
+        if (i < n && (s[i] == '+' || s[i] == '-')) i++;
+        if (i >= n || !isDigit(s[i])) return 0;
+        while (i < n && isDigit(s[i])) i++;
+    }
+    return i - begin;
+}
+
+static int scan_literal(const char* s, int n, int begin, uint8_t* type) {
+    static const char* words[] = { [TTrue] = "true", [TFalse] = "false", [TNUll] = "null" };
+    *type = s[begin] == 't' ? TTrue : s[begin] == 'f' ? TFalse : TNUll;
+    const char* word = words[*type];
+    int len = strlen(word);
+    if (n - begin < len || memcmp(s + begin, word, len) != 0) return 0;
+    if (begin + len < n) {
+        char next = s[begin + len];
+        if (('a' <= next && next <= 'z') || ('A' <= next && next <= 'Z') || isDigit(next)) return 0;
+    }
+    return len;
+}
+
+// stage 1 looks at 64 bytes at a time and turns them into bit masks, bit i stands for byte i of the block
+typedef struct {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t space;
+    uint64_t op;    // {}[]:,
+    uint64_t ctrl;  // bytes below 0x20, not allowed in strings
+} BlockMasks;
+
+typedef void (*ScanBlockFn)(const uint8_t* p, BlockMasks* m);
+
+#define SB_QUOTE 1
+#define SB_BACKSLASH 2
+#define SB_SPACE 4
+#define SB_OP 8
+#define SB_CTRL 16
+
+static const uint8_t scan_bits[256] = {
+    [0 ... 0x1f] = SB_CTRL,
+    ['\t'] = SB_CTRL | SB_SPACE,
+    ['\n'] = SB_CTRL | SB_SPACE,
+    ['\r'] = SB_CTRL | SB_SPACE,
+    [' '] = SB_SPACE,
+    ['"'] = SB_QUOTE,
+    ['\\'] = SB_BACKSLASH,
+    ['{'] = SB_OP,
+    ['}'] = SB_OP,
+    ['['] = SB_OP,
+    [']'] = SB_OP,
+    [':'] = SB_OP,
+    [','] = SB_OP,
+};
+
+static void scan_block_scalar(const uint8_t* p, BlockMasks* m) {
+    memset(m, 0, sizeof(*m));
+    for (int i = 0; i < 64; i++) {
+        uint8_t b = scan_bits[p[i]];
+        if (b == 0) continue;
+        uint64_t bit = (uint64_t) 1 << i;
+        if (b & SB_QUOTE) m->quote |= bit;
+        if (b & SB_BACKSLASH) m->backslash |= bit;
+        if (b & SB_SPACE) m->space |= bit;
+        if (b & SB_OP) m->op |= bit;
+        if (b & SB_CTRL) m->ctrl |= bit;
+    }
+}
+
+#ifdef __SSE2__
+#include <immintrin.h>
+
+static uint64_t eq_sse2(__m128i v, char c) {
+    return (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+}
+
+static void scan_block_sse2(const uint8_t* p, BlockMasks* m) {
+    memset(m, 0, sizeof(*m));
+    for (int k = 0; k < 4; k++) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (p + 16 * k));
+        // '[' and ']' are '{' and '}' without the 0x20 bit
+        __m128i low = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1f)), v);
+        int shift = 16 * k;
+        m->quote |= eq_sse2(v, '"') << shift;
+        m->backslash |= eq_sse2(v, '\\') << shift;
+        m->space |= (eq_sse2(v, ' ') | eq_sse2(v, '\t') | eq_sse2(v, '\n') | eq_sse2(v, '\r')) << shift;
+        m->op |= (eq_sse2(low, '{') | eq_sse2(low, '}') | eq_sse2(v, ':') | eq_sse2(v, ',')) << shift;
+        m->ctrl |= (uint64_t) (uint16_t) _mm_movemask_epi8(ctrl) << shift;
+    }
+}
+
+__attribute__((target("avx2"))) static inline uint64_t eq_avx2(__m256i v, char c) {
+    return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)));
+}
+
+__attribute__((target("avx2"))) static void scan_block_avx2(const uint8_t* p, BlockMasks* m) {
+    memset(m, 0, sizeof(*m));
+    for (int k = 0; k < 2; k++) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (p + 32 * k));
+        __m256i low = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i ctrl = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1f)), v);
+        int shift = 32 * k;
+        m->quote |= eq_avx2(v, '"') << shift;
+        m->backslash |= eq_avx2(v, '\\') << shift;
+        m->space |= (eq_avx2(v, ' ') | eq_avx2(v, '\t') | eq_avx2(v, '\n') | eq_avx2(v, '\r')) << shift;
+        m->op |= (eq_avx2(low, '{') | eq_avx2(low, '}') | eq_avx2(v, ':') | eq_avx2(v, ',')) << shift;
+        m->ctrl |= (uint64_t) (uint32_t) _mm256_movemask_epi8(ctrl) << shift;
+    }
+}
+#endif
+
+static JsonScanKind scanKind = JsonScanAuto;
+
+static JsonScanKind best_scan_kind() {
+#ifdef __SSE2__
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return JsonScanAvx2;
+    return JsonScanSse2;
+#else
+    return JsonScanScalar;
+#endif
+}
+
+// parses on several threads resolve the kind at the same time, every access is atomic
+JsonScanKind minijson_set_scan(JsonScanKind kind) {
+    JsonScanKind best = best_scan_kind();
+    JsonScanKind k = kind == JsonScanAuto || kind > best ? best : kind;
+    __atomic_store_n(&scanKind, k, __ATOMIC_RELAXED);
+    return k;
+}
+
+static ScanBlockFn scan_block_fn() {
+    JsonScanKind kind = __atomic_load_n(&scanKind, __ATOMIC_RELAXED);
+    if (kind == JsonScanAuto) kind = minijson_set_scan(JsonScanAuto);
+    switch (kind) {
+#ifdef __SSE2__
+    case JsonScanAvx2:
+        return scan_block_avx2;
+    case JsonScanSse2:
+        return scan_block_sse2;
+#endif
     default:
-        return false;
+        return scan_block_scalar;
+    }
+}
+
+// bit i of the result is the xor of bits 0..i
+static uint64_t prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+// the offsets of every structural character, string quote (opening and closing) and scalar start outside strings
+typedef struct {
+    uint32_t* offsets;
+    int len;
+    int ctrlPos;  // the first control character inside a string, -1 if none
+} StructIndex;
+
+static int build_index(StructIndex* idx, const char* s, int n) {
+    ScanBlockFn scan = scan_block_fn();
+    int cap = n / 4 + 64;
+    idx->offsets = malloc(cap * sizeof(uint32_t));
+    idx->len = 0;
+    idx->ctrlPos = -1;
+    if (idx->offsets == NULL) return -1;
+
+    // state carried from one block to the next
+    uint64_t prevEscaped = 0;  // the first byte of the block is escaped
+    uint64_t prevInString = 0;  // all ones when the block starts inside a string
+    uint64_t prevScalar = 0;  // the last byte of the block before was part of a scalar
+    for (int base = 0; base < n; base += 64) {
+        BlockMasks m;
+        if (n - base >= 64) {
+            scan((const uint8_t*) s + base, &m);
+        } else {
+            uint8_t tail[64];
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, s + base, n - base);
+            scan(tail, &m);
+        }
+
+        // a backslash escapes the next byte unless it is escaped itself, sequences are rare so walk them one by one
+        uint64_t escaped = prevEscaped;
+        prevEscaped = 0;
+        for (uint64_t bs = m.backslash & ~escaped; bs != 0; bs &= bs - 1) {
+            int i = __builtin_ctzll(bs);
+            if (escaped >> i & 1) continue;
+            if (i == 63) {
+                prevEscaped = 1;
+            } else {
+                escaped |= (uint64_t) 1 << (i + 1);
+            }
+        }
+
+        // the string mask covers an opening quote and the body, not the closing quote
+        uint64_t quote = m.quote & ~escaped;
+        uint64_t inString = prefix_xor(quote) ^ prevInString;
+        prevInString = (uint64_t) ((int64_t) inString >> 63);
+
+        uint64_t ctrl = m.ctrl & inString;
+        if (ctrl != 0 && idx->ctrlPos < 0) idx->ctrlPos = base + __builtin_ctzll(ctrl);
+
+        uint64_t scalar = ~(m.space | m.op | quote | inString);
+        uint64_t scalarStart = scalar & ~(scalar << 1 | prevScalar);
+        prevScalar = scalar >> 63;
+
+        uint64_t bits = (m.op & ~inString) | quote | scalarStart;
+        if (idx->len + 64 > cap) {
+            cap *= 2;
+            uint32_t* offsets = realloc(idx->offsets, cap * sizeof(uint32_t));
+            if (offsets == NULL) return -1;
+            idx->offsets = offsets;
+        }
+        for (; bits != 0; bits &= bits - 1) {
+            int i = base + __builtin_ctzll(bits);
+            // the padding of the last block is not input
+            if (i >= n) break;
+            idx->offsets[idx->len++] = i;
+        }
+    }
+    return 0;
+}
+
+static void tape_push(Tape* tape, uint8_t type, uint8_t flags, int offset, int len) {
+    Token* tk = &tape->tokens[tape->len++];
+    tk->type = type;
+    tk->flags = flags;
+    tk->offset = offset;
+    tk->len = len;
+}
+
+// a number or literal runs up to a space, a structural character or a quote, "12x" is not a number
+static bool ends_scalar(const char* s, int n, int end) {
+    if (end == n) return true;
+    int cls = char_class[(unsigned char) s[end]];
+    return cls == CSpace || cls == CStruct || cls == CQuote;
+}
+
+// stage 2 visits only the indexed offsets and writes the tokens, ends with TEnd or with TError at the bad byte
+static int tokenize(Tape* tape, const char* s, int n) {
+    StructIndex idx;
+    tape->tokens = NULL;
+    if (build_index(&idx, s, n) != 0) {
+        free(idx.offsets);
+        return -1;
+    }
+    // at most one token per offset, plus the last one
+    tape->len = 0;
+    tape->tokens = malloc((idx.len + 1) * sizeof(Token));
+    if (tape->tokens == NULL) {
+        free(idx.offsets);
+        return -1;
+    }
+
+    int bad = -1;
+    for (int k = 0; k < idx.len; k++) {
+        int i = idx.offsets[k];
+        unsigned char c = s[i];
+        uint8_t type = TError;
+        uint8_t flags = 0;
+        int len = 0;
+        bool scalar = false;
+        switch (char_class[c]) {
+        case CStruct:
+            type = struct_type[c];
+            len = 1;
+            break;
+        case CQuote: {
+            // the closing quote is the next offset, nothing inside a string is indexed
+            if (k + 1 == idx.len) break;
+            int end = idx.offsets[++k];
+            if (idx.ctrlPos >= 0 && idx.ctrlPos < end) break;
+            if (memchr(s + i + 1, '\\', end - i - 1) != NULL) flags |= TK_ESCAPED;
+            type = TStr;
+            len = end + 1 - i;
+            break;
+        }
+        case CNum:
+            type = TNum;
+            len = scan_num(s, n, i, &flags);
+            scalar = true;
+            break;
+        case CLit:
+            len = scan_literal(s, n, i, &type);
+            scalar = true;
+            break;
+        default:
+            break;
+        }
+        if (len == 0) {
+            bad = i;
+            break;
+        }
+        tape_push(tape, type, flags, i, len);
+        // no rule takes a value right after a scalar, so the parser stops at the same byte as with "12 x"
+        if (scalar && !ends_scalar(s, n, i + len)) {
+            bad = i + len;
+            break;
+        }
+    }
+    if (bad >= 0) {
+        tape_push(tape, TError, 0, bad, 0);
+    } else {
+        tape_push(tape, TEnd, 0, n, 0);
+    }
+    free(idx.offsets);
+    return 0;
+}
+
+typedef struct {
+    const char* src;
+    bool view;
+    const Token* tape;
+    int pos;
+    JsonArena* arena;
+    // the members of the open containers, a closed container copies its own into the arena
+    JsonBaseObj* values;
+    int valuesLen;
+    int valuesCap;
+    JsonStr* keys;
+    int keysLen;
+    int keysCap;
+    int depth;
+} Parser;
+
+// the tape always ends with TEnd or TError, which no rule consumes, so the parser never walks past it
+static const Token* tape_peek(const Parser* p) {
+    return &p->tape[p->pos];
+}
+
+static bool tape_expect(const Parser* p, TokenType expect) {
+    return p->tape[p->pos].type == expect;
+}
+
+static void tape_next(Parser* p) {
+    p->pos++;
+}
+
+static int hex_value(const char* s) {
+    int v = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = s[i];
+        v <<= 4;
+        if (isDigit(c)) {
+            v |= c - '0';
+        } else if ('a' <= (c | 0x20) && (c | 0x20) <= 'f') {
+            v |= (c | 0x20) - 'a' + 10;
+        } else {
+            return -1;
+        }
     }
+    return v;
 }
 
-static int skip_empty(const char* cs) {
-    for (int i = 0;; i++) {
-        if (!isEmpty(cs[i])) return i;
+static int utf8_encode(char* out, unsigned cp) {
+    if (cp < 0x80) {
+        out[0] = cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = 0xc0 | cp >> 6;
+        out[1] = 0x80 | (cp & 0x3f);
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = 0xe0 | cp >> 12;
+        out[1] = 0x80 | (cp >> 6 & 0x3f);
+        out[2] = 0x80 | (cp & 0x3f);
+        return 3;
     }
+    out[0] = 0xf0 | cp >> 18;
+    out[1] = 0x80 | (cp >> 12 & 0x3f);
+    out[2] = 0x80 | (cp >> 6 & 0x3f);
+    out[3] = 0x80 | (cp & 0x3f);
+    return 4;
 }
 
-static int find_empty(const char* cs) {
-    for (int i = 0;; i++) {
-        if (isEmpty(cs[i])) return i;
+// unescape the raw string between the quotes into dst, which holds at least len + 1 bytes
+static int jstr_unescape(char* dst, const char* src, int len) {
+    int n = 0;
+    for (int i = 0; i < len; i++) {
+        if (src[i] != '\\') {
+            dst[n++] = src[i];
+            continue;
+        }
+        i++;
+        switch (src[i]) {
+        case '"':
+        case '\\':
+        case '/':
+            dst[n++] = src[i];
+            break;
+        case 'b':
+            dst[n++] = '\b';
+            break;
+        case 'f':
+            dst[n++] = '\f';
+            break;
+        case 'n':
+            dst[n++] = '\n';
+            break;
+        case 'r':
+            dst[n++] = '\r';
+            break;
+        case 't':
+            dst[n++] = '\t';
+            break;
+        case 'u': {
+            if (i + 4 >= len) return -1;
+            int cp = hex_value(src + i + 1);
+            if (cp < 0) return -1;
+            i += 4;
+            // a high surrogate followed by a low one is a single code point
+            if (0xd800 <= cp && cp < 0xdc00 && i + 6 < len && src[i + 1] == '\\' && src[i + 2] == 'u') {
+                int lo = hex_value(src + i + 3);
+                if (0xdc00 <= lo && lo < 0xe000) {
+                    cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+                    i += 6;
+                }
+            }
+            n += utf8_encode(dst + n, cp);
+            break;
+        }
+        default:
+            return -1;
+        }
     }
+    dst[n] = '\0';
+    return n;
 }
 
-int jnum_from_cstr(JsonNum* num, const char* cs, int n) {
-    int64_t intRes;
-    double floatRes;
+// the escapes of a raw string are well formed, a view checks them at parse time so resolving it cannot fail
+static bool jstr_valid_escapes(const char* src, int len) {
+    for (int i = 0; i < len; i++) {
+        if (src[i] != '\\') continue;
+        i++;
+        switch (src[i]) {
+        case '"':
+        case '\\':
+        case '/':
+        case 'b':
+        case 'f':
+        case 'n':
+        case 'r':
+        case 't':
+            break;
+        case 'u':
+            if (i + 4 >= len || hex_value(src + i + 1) < 0) return false;
+            i += 4;
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
 
-    if (strlen(cs) <= n) {
+// keys are never left escaped, a lookup compares them without the document at hand
+static int parse_str(Parser* p, JsonStr* str, bool isKey) {
+    const Token* tk = tape_peek(p);
+    if (tk->type != TStr) return -1;
+    const char* raw = p->src + tk->offset + 1;
+    int rawLen = tk->len - 2;
+    bool escaped = tk->flags & TK_ESCAPED;
+
+    if (p->view && (!escaped || !isKey)) {
+        if (escaped && !jstr_valid_escapes(raw, rawLen)) return -1;
+        str->data = (char*) raw;
+        str->len = rawLen;
+        str->cap = escaped ? JSTR_ESCAPED : JSTR_VIEW;
+        tape_next(p);
         return 0;
     }
 
-    int preEmpty = skip_empty(cs);
-    cs += preEmpty;
+    str->data = jarena_alloc(p->arena, rawLen + 1);
+    if (str->data == NULL) return -1;
+    if (!escaped) {
+        memcpy(str->data, raw, rawLen);
+        str->data[rawLen] = '\0';
+        str->len = rawLen;
+    } else {
+        str->len = jstr_unescape(str->data, raw, rawLen);
+    }
+    str->cap = rawLen + 1;
+    if (str->len < 0) return -1;
+    tape_next(p);
+    return 0;
+}
 
-    char* temp = malloc(sizeof(char) * (n + 1));
-    strcpy(temp, cs);
+const char* jstr_resolve(JsonDoc* doc, JsonStr* str) {
+    if (str->cap != JSTR_ESCAPED) return str->data;
+    char* data = jarena_alloc(&doc->arena, str->len + 1);
+    if (data == NULL) return NULL;
+    str->len = jstr_unescape(data, str->data, str->len);
+    str->cap = str->len + 1;
+    str->data = data;
+    return data;
+}
 
-    int res = sscanf(cs, "%ld", &intRes);
-    if (res != 0) {
-        num->isInt = true;
-        num->Double = intRes;
-        return n;
+// s holds len bytes of a number scan_num accepted, tmp is used for long numbers when not NULL
+static int num_convert(JsonNum* num, const char* s, int len, bool isFloat, JsonArena* tmp) {
+    // integers that fit in int64 are read directly, 19 digits cannot overflow uint64
+    bool neg = s[0] == '-';
+    int digits = len - neg;
+    if (digits <= 19 && !isFloat) {
+        uint64_t v = 0;
+        for (int i = neg; i < len; i++) {
+            v = v * 10 + (s[i] - '0');
+        }
+        if (v <= (uint64_t) INT64_MAX + neg) {
+            num->isInt = true;
+            num->Int64 = neg ? (int64_t) -v : (int64_t) v;
+            num->Double = num->Int64;
+            return 0;
+        }
+    }
+    char buf[64];
+    char* str = buf;
+    if (len >= (int) sizeof(buf)) {
+        str = tmp != NULL ? jarena_alloc(tmp, len + 1) : malloc(len + 1);
+        if (str == NULL) return -1;
     }
+    memcpy(str, s, len);
+    str[len] = '\0';
+    num->isInt = false;
+    num->Double = strtod(str, NULL);
+    // outside the int64 range the conversion is undefined, clamp instead
+    if (num->Double >= -0x1p63 && num->Double < 0x1p63) {
+        num->Int64 = num->Double;
+    } else {
+        num->Int64 = num->Double > 0 ? INT64_MAX : INT64_MIN;
+    }
+    if (str != buf && tmp == NULL) free(str);
+    return 0;
+}
 
-    res = sscanf(cs, "%lf", &floatRes);
-    if (res != 0) {
-        num->isInt = false;
-        num->Double = floatRes;
-        return n;
+static int parse_num(Parser* p, JsonNum* num) {
+    const Token* tk = tape_peek(p);
+    if (tk->type != TNum) return -1;
+    if (num_convert(num, p->src + tk->offset, tk->len, tk->flags & TK_FLOAT, p->arena) != 0) return -1;
+    tape_next(p);
+    return 0;
+}
+
+static int push_value(Parser* p, const JsonBaseObj* obj) {
+    if (p->valuesLen == p->valuesCap) {
+        int cap = p->valuesCap == 0 ? 64 : p->valuesCap * 2;
+        JsonBaseObj* values = realloc(p->values, cap * sizeof(JsonBaseObj));
+        if (values == NULL) return -1;
+        p->values = values;
+        p->valuesCap = cap;
     }
+    p->values[p->valuesLen++] = *obj;
+    return 0;
+}
 
-    free(temp);
+static int push_key(Parser* p, const JsonStr* key) {
+    if (p->keysLen == p->keysCap) {
+        int cap = p->keysCap == 0 ? 64 : p->keysCap * 2;
+        JsonStr* keys = realloc(p->keys, cap * sizeof(JsonStr));
+        if (keys == NULL) return -1;
+        p->keys = keys;
+        p->keysCap = cap;
+    }
+    p->keys[p->keysLen++] = *key;
     return 0;
 }
 
-void init_jstr(JsonStr* str) {
-    str->len = 0;
-    str->cap = 100;
-    str->data = calloc(sizeof(char), INIT_JSTR_LEN);
+static int parse_base_obj(Parser* p, JsonBaseObj* obj);
+
+static int parse_array(Parser* p, JsonArray* arr) {
+    if (!tape_expect(p, TLBracket)) return -1;
+    tape_next(p);
+    int base = p->valuesLen;
+
+    if (!tape_expect(p, TRBracket)) {
+        while (1) {
+            JsonBaseObj elem;
+            if (parse_base_obj(p, &elem) != 0 || push_value(p, &elem) != 0) return -1;
+            if (!tape_expect(p, TComma)) break;
+            tape_next(p);
+        }
+    }
+    if (!tape_expect(p, TRBracket)) return -1;
+    tape_next(p);
+
+    arr->length = p->valuesLen - base;
+    arr->list = jarena_alloc(p->arena, arr->length * sizeof(JsonBaseObj));
+    if (arr->list == NULL && arr->length != 0) return -1;
+    // the stack is not allocated yet when no value was pushed
+    if (arr->length != 0) memcpy(arr->list, p->values + base, arr->length * sizeof(JsonBaseObj));
+    p->valuesLen = base;
+    return 0;
 }
 
-int _jstr_adjust_cap(JsonStr* str, int newCap) {
-    if (str->len + 1 <= newCap) {
-        str->data = realloc(str->data, newCap);
-        return newCap;
+static uint32_t key_hash(const char* s, int len) {
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ len;
+    for (; len >= 8; s += 8, len -= 8) {
+        uint64_t w;
+        memcpy(&w, s, 8);
+        h = (h ^ w) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
     }
+    uint64_t w = 0;
+    memcpy(&w, s, len);
+    h = (h ^ w) * 0xff51afd7ed558ccdull;
+    return h ^ h >> 29;
+}
 
+static bool key_equal(const JsonStr* k, const char* key, int len) {
+    return k->len == len && memcmp(k->data, key, len) == 0;
+}
+
+// open addressing with linear probing at most half full, a duplicate key stays behind the first one
+static int map_index(JsonMap* map, JsonArena* arena) {
+    map->index = NULL;
+    map->indexMask = 0;
+    if (map->len < MAP_INDEX_MIN) return 0;
+    uint32_t slots = 1;
+    while (slots < 2 * (uint32_t) map->len) slots *= 2;
+    map->index = jarena_alloc(arena, slots * sizeof(uint32_t));
+    if (map->index == NULL) return -1;
+    memset(map->index, 0, slots * sizeof(uint32_t));
+    map->indexMask = slots - 1;
+    for (int i = 0; i < map->len; i++) {
+        uint32_t h = key_hash(map->keyList[i].data, map->keyList[i].len) & map->indexMask;
+        while (map->index[h] != 0) h = (h + 1) & map->indexMask;
+        map->index[h] = i + 1;
+    }
     return 0;
 }
 
-int jstr_cpy(JsonStr* dst, const JsonStr* src) {
-    memcpy(dst, src, sizeof(JsonStr));
-    dst->data = malloc(src->cap);
-    memcpy(dst->data, src->data, src->cap);
-    return dst->len;
+JsonBaseObj* minijson_map_get(const JsonMap* map, const char* key, int len) {
+    if (map->index == NULL) {
+        for (int i = 0; i < map->len; i++) {
+            if (key_equal(&map->keyList[i], key, len)) return &map->valueList[i];
+        }
+        return NULL;
+    }
+    uint32_t h = key_hash(key, len) & map->indexMask;
+    for (; map->index[h] != 0; h = (h + 1) & map->indexMask) {
+        int i = map->index[h] - 1;
+        if (key_equal(&map->keyList[i], key, len)) return &map->valueList[i];
+    }
+    return NULL;
 }
 
-int jstr_cpy_cstr(JsonStr* str, const char* cs, int len) {
-    if (str->cap <= len) {
-        str->cap = len * 2;
-        str->data = realloc(str->data, str->cap);
+static int parse_map(Parser* p, JsonMap* map) {
+    if (!tape_expect(p, TLBrace)) return -1;
+    tape_next(p);
+    int valueBase = p->valuesLen;
+    int keyBase = p->keysLen;
+
+    if (!tape_expect(p, TRBrace)) {
+        while (1) {
+            JsonStr key;
+            JsonBaseObj value;
+            if (parse_str(p, &key, true) != 0 || push_key(p, &key) != 0) return -1;
+            if (!tape_expect(p, TColon)) return -1;
+            tape_next(p);
+            if (parse_base_obj(p, &value) != 0 || push_value(p, &value) != 0) return -1;
+            if (!tape_expect(p, TComma)) break;
+            tape_next(p);
+        }
     }
+    if (!tape_expect(p, TRBrace)) return -1;
+    tape_next(p);
+
+    map->len = p->keysLen - keyBase;
+    map->cap = map->len;
+    map->keyList = jarena_alloc(p->arena, map->len * sizeof(JsonStr));
+    map->valueList = jarena_alloc(p->arena, map->len * sizeof(JsonBaseObj));
+    if ((map->keyList == NULL || map->valueList == NULL) && map->len != 0) return -1;
+    if (map->len != 0) {
+        memcpy(map->keyList, p->keys + keyBase, map->len * sizeof(JsonStr));
+        memcpy(map->valueList, p->values + valueBase, map->len * sizeof(JsonBaseObj));
+    }
+    p->keysLen = keyBase;
+    p->valuesLen = valueBase;
+    return map_index(map, p->arena);
+}
 
-    strncpy(str->data, cs, len);
-    str->data[len] = '\0';
-    str->len = len;
+static int parse_base_obj(Parser* p, JsonBaseObj* obj) {
+    const Token* tk = tape_peek(p);
+    int ret = 0;
+    switch (tk->type) {
+    case TLBrace:
+    case TLBracket:
+        if (++p->depth > MAX_DEPTH) return -1;
+        if (tk->type == TLBrace) {
+            obj->type = JMap;
+            ret = parse_map(p, &obj->jsonMap);
+        } else {
+            obj->type = JArray;
+            ret = parse_array(p, &obj->jsonArray);
+        }
+        p->depth--;
+        return ret;
+    case TStr:
+        obj->type = JStr;
+        return parse_str(p, &obj->jsonStr, false);
+    case TNum:
+        obj->type = JNum;
+        return parse_num(p, &obj->jsonNum);
+    case TTrue:
+    case TFalse:
+        obj->type = JBool;
+        obj->jsonBool.data = tk->type == TTrue;
+        tape_next(p);
+        return 0;
+    case TNUll:
+        obj->type = JNull;
+        tape_next(p);
+        return 0;
+    default:
+        return -1;
+    }
+}
 
-    return len;
+static JsonDoc* parse_doc(const char* str, int len, bool view, int* errPos) {
+    JsonArena arena = { NULL };
+    JsonDoc* doc = jarena_alloc(&arena, sizeof(JsonDoc));
+    if (doc == NULL) return NULL;
+
+    Tape tape;
+    Parser p = { .src = str, .view = view, .arena = &arena };
+    int ret = tokenize(&tape, str, len);
+    if (ret == 0) {
+        p.tape = tape.tokens;
+        ret = parse_base_obj(&p, &doc->root);
+        if (ret == 0 && !tape_expect(&p, TEnd)) ret = -1;
+    }
+    free(p.values);
+    free(p.keys);
+
+    if (ret != 0) {
+        if (errPos != NULL) *errPos = p.tape != NULL ? tape_peek(&p)->offset : 0;
+        free(tape.tokens);
+        jarena_free(&arena);
+        return NULL;
+    }
+    free(tape.tokens);
+    doc->arena = arena;
+    return doc;
 }
 
-const char* jstr_cstr(const JsonStr* str) {
-    return str->data;
+JsonDoc* minijson_parse_str(const char* str, int len, int* errPos) {
+    return parse_doc(str, len, false, errPos);
+}
+
+JsonDoc* minijson_parse_view(const char* str, int len, int* errPos) {
+    return parse_doc(str, len, true, errPos);
+}
+
+void minijson_free(JsonDoc* doc) {
+    if (doc == NULL) return;
+    JsonArena arena = doc->arena;
+    jarena_free(&arena);
+}
+
+// the streaming parser keeps no document, only the open containers and the token cut by a chunk boundary
+
+typedef enum {
+    SaxRoot,  // a top level value or the end of the stream
+    SaxValue,
+    SaxValueOrEnd,
+    SaxKey,
+    SaxKeyOrEnd,
+    SaxColon,
+    SaxCommaOrEnd,
+} SaxExpect;
+
+typedef enum {
+    SaxNoToken,
+    SaxInStr,
+    SaxInNum,
+    SaxInLit,
+} SaxToken;
+
+struct JsonSax {
+    JsonSaxHandler h;
+    uint8_t expect;
+    uint8_t token;
+    bool isKey;       // the open string is a key
+    bool escaped;     // the open string holds an escape
+    bool escapeNext;  // the last chunk ended right after a backslash
+    // the part of the open token seen in earlier chunks, and a string that needs unescaping
+    char* buf;
+    int bufLen;
+    int bufCap;
+    // '{' or '[' for every open container
+    char* stack;
+    int depth;
+    int stackCap;
+    int64_t offset;      // stream offset of the chunk being fed
+    int64_t tokenStart;  // stream offset of the open token, a bad token is reported there
+    int64_t errPos;
+};
+
+JsonSax* minijson_sax_new(const JsonSaxHandler* handler) {
+    JsonSax* sax = calloc(1, sizeof(JsonSax));
+    if (sax == NULL) return NULL;
+    sax->h = *handler;
+    sax->errPos = -1;
+    return sax;
+}
+
+void minijson_sax_free(JsonSax* sax) {
+    if (sax == NULL) return;
+    free(sax->buf);
+    free(sax->stack);
+    free(sax);
+}
+
+int64_t minijson_sax_errpos(const JsonSax* sax) {
+    return sax->errPos;
+}
+
+static int sax_fail(JsonSax* sax, int i) {
+    sax->errPos = sax->offset + i;
+    return -1;
+}
+
+static int sax_fail_token(JsonSax* sax) {
+    sax->errPos = sax->tokenStart;
+    return -1;
+}
+
+// one byte more than asked, for the terminator of an unescaped string
+static int sax_append(JsonSax* sax, const char* data, int len) {
+    if (sax->bufLen + len + 1 > sax->bufCap) {
+        int cap = sax->bufCap == 0 ? 256 : sax->bufCap;
+        while (cap < sax->bufLen + len + 1) cap *= 2;
+        char* buf = realloc(sax->buf, cap);
+        if (buf == NULL) return -1;
+        sax->buf = buf;
+        sax->bufCap = cap;
+    }
+    memcpy(sax->buf + sax->bufLen, data, len);
+    sax->bufLen += len;
+    return 0;
 }
 
-int jstr_to_jnum(const JsonStr* str, JsonNum* num) {
-    return jnum_from_cstr(num, jstr_cstr(str), str->len);
+static bool sax_expects_value(const JsonSax* sax) {
+    return sax->expect == SaxRoot || sax->expect == SaxValue || sax->expect == SaxValueOrEnd;
 }
 
-int jstr_append(JsonStr* str, char newch) {
-    if (str->cap <= str->len - 1) {
-        _jstr_adjust_cap(str, str->cap * 2);
+static int sax_after_value(JsonSax* sax) {
+    if (sax->depth > 0) {
+        sax->expect = SaxCommaOrEnd;
+        return 0;
     }
+    sax->expect = SaxRoot;
+    return sax->h.endDocument != NULL ? sax->h.endDocument(sax->h.ctx) : 0;
+}
 
-    str->data[str->len] = newch;
-    str->len++;
-    str->data[str->len] = '\0';
-    return str->len;
+static int sax_value(JsonSax* sax, const JsonBaseObj* value) {
+    if (sax->h.value != NULL && sax->h.value(sax->h.ctx, value) != 0) return -1;
+    return sax_after_value(sax);
 }
 
-int jstr_from_str(JsonStr* dst, const char* src) {
-    if (src[0] != '\"') return 0;
-    for (int i = 1; src[i] != '\0'; i++) {
-        if (src[i] == '\\' && src[i + 1] != '\0') {
+// i is the first byte of the chunk after the opening quote or the cut
+static int sax_str(JsonSax* sax, const char* s, int len, int i) {
+    int start = i;
+    if (sax->escapeNext && i < len) {
+        sax->escapeNext = false;
+        i++;
+    }
+    while (i < len) {
+        unsigned char c = s[i];
+        uint8_t b = scan_bits[c] & (SB_QUOTE | SB_BACKSLASH | SB_CTRL);
+        if (b == 0) {
             i++;
             continue;
         }
-        if (src[i] == '"') {
-            jstr_cpy_cstr(dst, src + 1, i - 1);
-            return i;
+        if (b & SB_CTRL) return sax_fail_token(sax);
+        if (b & SB_BACKSLASH) {
+            sax->escaped = true;
+            if (i + 1 == len) {
+                sax->escapeNext = true;
+                i++;
+            } else {
+                i += 2;
+            }
+            continue;
+        }
+
+        // a string within one chunk and without escapes is passed on without a copy
+        const char* data = s + start;
+        int n = i - start;
+        if (sax->bufLen > 0 || sax->escaped) {
+            if (sax_append(sax, data, n) != 0) return sax_fail(sax, i);
+            data = sax->buf;
+            n = sax->escaped ? jstr_unescape(sax->buf, sax->buf, sax->bufLen) : sax->bufLen;
+            if (n < 0) return sax_fail_token(sax);
         }
+        sax->token = SaxNoToken;
+        sax->bufLen = 0;
+        int ret;
+        if (sax->isKey) {
+            sax->expect = SaxColon;
+            ret = sax->h.key != NULL ? sax->h.key(sax->h.ctx, data, n) : 0;
+        } else {
+            JsonBaseObj value = { .type = JStr, .jsonStr = { n, JSTR_VIEW, (char*) data } };
+            ret = sax_value(sax, &value);
+        }
+        return ret == 0 ? i + 1 : sax_fail(sax, i);
     }
+    if (sax_append(sax, s + start, len - start) != 0) return sax_fail(sax, len);
+    return len;
+}
+
+// sets errPos on failure, a bad token is reported where its valid prefix ends as the document parser does
+static int sax_scalar_end(JsonSax* sax, const char* data, int n) {
+    JsonBaseObj value;
+    uint8_t flags = 0;
+    uint8_t type;
+    int len;
+    if (sax->token == SaxInNum) {
+        len = scan_num(data, n, 0, &flags);
+        value.type = JNum;
+        if (len == n && num_convert(&value.jsonNum, data, n, flags & TK_FLOAT, NULL) != 0) return sax_fail_token(sax);
+    } else {
+        len = scan_literal(data, n, 0, &type);
+        value.type = type == TNUll ? JNull : JBool;
+        value.jsonBool.data = type == TTrue;
+    }
+    if (len != n) {
+        sax->errPos = sax->tokenStart + len;
+        return -1;
+    }
+    sax->token = SaxNoToken;
+    sax->bufLen = 0;
+    if (sax_value(sax, &value) != 0) return sax_fail_token(sax);
     return 0;
 }
 
-typedef enum {
-    TNum,
-    TStr,
-    TTrue,
-    TFalse,
-    TNUll,
-    TLBrace,
-    TRBrace,
-    TComma,
-    TColon,
-    TLBracket,
-    TRBracket,
-} TokenType;
+// the bytes a number or literal is cut from, the scan functions tell whether they make one
+static bool sax_scalar_byte(char c) {
+    return isDigit(c) || ('a' <= (c | 0x20) && (c | 0x20) <= 'z') || c == '-' || c == '+' || c == '.';
+}
 
-typedef struct {
-    TokenType type;
-    JsonStr content;
-} Token;
+// a number or literal ends at the first byte that cannot be part of one, which may be in a later chunk
+static int sax_scalar(JsonSax* sax, const char* s, int len, int i) {
+    int start = i;
+    while (i < len && sax_scalar_byte(s[i])) i++;
+    if (i == len) {
+        if (sax_append(sax, s + start, len - start) != 0) return sax_fail(sax, len);
+        return len;
+    }
+    const char* data = s + start;
+    int n = i - start;
+    if (sax->bufLen > 0) {
+        if (sax_append(sax, data, n) != 0) return sax_fail(sax, i);
+        data = sax->buf;
+        n = sax->bufLen;
+    }
+    return sax_scalar_end(sax, data, n) == 0 ? i : -1;
+}
 
-typedef struct {
-    const char* src;
-    int cursor;
-    bool isFinished;
-    Token curToken;
-    int curLen;
-} Lexer;
-
-int init_lexer(Lexer* l, const char* src) {
-    l->src = src;
-    l->cursor = 0;
-    l->isFinished = false;
-    l->curLen = 0;
-    init_jstr(&l->curToken.content);
+static int sax_push(JsonSax* sax, char c) {
+    if (sax->depth == MAX_DEPTH) return -1;
+    if (sax->depth == sax->stackCap) {
+        int cap = sax->stackCap == 0 ? 64 : sax->stackCap * 2;
+        char* stack = realloc(sax->stack, cap);
+        if (stack == NULL) return -1;
+        sax->stack = stack;
+        sax->stackCap = cap;
+    }
+    sax->stack[sax->depth++] = c;
     return 0;
 }
 
-const Token* lexer_peek(Lexer* l) {
-    const char* curStr = l->src + l->cursor;
-    const int preEmpty = skip_empty(curStr);
-    const char* str = curStr + preEmpty;
-    int len;  // the token actual lenth(no empty chars)
-    switch (str[0]) {
+static int sax_struct(JsonSax* sax, char c) {
+    char top = sax->depth > 0 ? sax->stack[sax->depth - 1] : 0;
+    int (*cb)(void*) = NULL;
+    switch (c) {
     case '{':
-        len = 1;
-        l->curToken.type = TLBrace;
-    case '}':
-        len = 1;
-        l->curToken.type = TRBrace;
     case '[':
-        len = 1;
-        l->curToken.type = TLBracket;
+        if (!sax_expects_value(sax) || sax_push(sax, c) != 0) return -1;
+        sax->expect = c == '{' ? SaxKeyOrEnd : SaxValueOrEnd;
+        cb = c == '{' ? sax->h.beginObject : sax->h.beginArray;
+        return cb != NULL ? cb(sax->h.ctx) : 0;
+    case '}':
     case ']':
-        len = 1;
-        l->curToken.type = TRBracket;
+        if (c == '}' && (top != '{' || (sax->expect != SaxKeyOrEnd && sax->expect != SaxCommaOrEnd))) return -1;
+        if (c == ']' && (top != '[' || (sax->expect != SaxValueOrEnd && sax->expect != SaxCommaOrEnd))) return -1;
+        sax->depth--;
+        cb = c == '}' ? sax->h.endObject : sax->h.endArray;
+        if (cb != NULL && cb(sax->h.ctx) != 0) return -1;
+        return sax_after_value(sax);
     case ':':
-        len = 1;
-        l->curToken.type = TColon;
-    case ',':
-        len = 1;
-        l->curToken.type = TComma;
+        if (sax->expect != SaxColon) return -1;
+        sax->expect = SaxValue;
+        return 0;
     default:
-        break;
+        if (sax->expect != SaxCommaOrEnd) return -1;
+        sax->expect = top == '{' ? SaxKey : SaxValue;
+        return 0;
     }
+}
 
-    if (len != 0) goto finish;
-
-    if (strncmp(str, "null", 4) && isEmpty(str[4])) {
-        l->curToken.type = TNUll;
-        len = 4;
+static int sax_token(JsonSax* sax, const char* s, int len, int i) {
+    unsigned char c = s[i];
+    switch (char_class[c]) {
+    case CSpace:
+        while (i < len && char_class[(unsigned char) s[i]] == CSpace) i++;
+        return i;
+    case CStruct:
+        return sax_struct(sax, c) == 0 ? i + 1 : sax_fail(sax, i);
+    case CQuote:
+        if (sax->expect == SaxKey || sax->expect == SaxKeyOrEnd) {
+            sax->isKey = true;
+        } else if (sax_expects_value(sax)) {
+            sax->isKey = false;
+        } else {
+            return sax_fail(sax, i);
+        }
+        sax->token = SaxInStr;
+        sax->tokenStart = sax->offset + i;
+        sax->escaped = false;
+        return sax_str(sax, s, len, i + 1);
+    case CNum:
+    case CLit:
+        if (!sax_expects_value(sax)) return sax_fail(sax, i);
+        sax->token = char_class[c] == CNum ? SaxInNum : SaxInLit;
+        sax->tokenStart = sax->offset + i;
+        return sax_scalar(sax, s, len, i);
+    default:
+        return sax_fail(sax, i);
     }
+}
 
-    if (strncmp(str, "true", 4) && isEmpty(str[4])) {
-        l->curToken.type = TTrue;
-        len = 4;
+int minijson_sax_feed(JsonSax* sax, const char* data, int len) {
+    if (sax->errPos >= 0) return -1;
+    int i = 0;
+    while (i < len) {
+        switch (sax->token) {
+        case SaxInStr:
+            i = sax_str(sax, data, len, i);
+            break;
+        case SaxInNum:
+        case SaxInLit:
+            i = sax_scalar(sax, data, len, i);
+            break;
+        default:
+            i = sax_token(sax, data, len, i);
+            break;
+        }
+        if (i < 0) return -1;
     }
+    sax->offset += len;
+    return 0;
+}
 
-    if (strncmp(str, "false", 5) && isEmpty(str[5])) {
-        l->curToken.type = TFalse;
-        len = 5;
+int minijson_sax_finish(JsonSax* sax) {
+    if (sax->errPos >= 0) return -1;
+    // only a number or literal can end with the stream, "1" is a whole document
+    if (sax->token == SaxInNum || sax->token == SaxInLit) {
+        if (sax_scalar_end(sax, sax->buf, sax->bufLen) != 0) return -1;
     }
+    if (sax->token == SaxInStr) return sax_fail_token(sax);
+    if (sax->expect != SaxRoot) return sax_fail(sax, 0);
+    return 0;
+}
 
-    JsonNum resNum;
-    len = jnum_from_cstr(&resNum, str, find_empty(str) + 1);
-    if (len != 0) goto finish;
+// shortest round trip doubles, after Ulf Adams' Ryu: the shortest decimal in the rounding interval of the double,
+// the closest one to it when several are that short
 
-    JsonStr resStr;
-    len = jstr_from_str(&resStr, str);
-    if (len != 0) goto finish;
+#define POW5_INV_BITCOUNT 125
+#define POW5_BITCOUNT 125
+#define POW5_INV_NUM 342
+#define POW5_NUM 326
 
-    return NULL;
-finish:
-    l->curLen = preEmpty + len;
-    return &l->curToken;
+typedef unsigned __int128 uint128;
+
+// 5^i cut to its top POW5_BITCOUNT bits and 2^k / 5^i rounded up to POW5_INV_BITCOUNT bits, as (low, high)
+static uint64_t pow5Split[POW5_NUM][2];
+static uint64_t pow5InvSplit[POW5_INV_NUM][2];
+
+// bit length of 5^e, for 0 <= e <= 3528
+static int pow5bits(int e) {
+    return (int) (((uint32_t) e * 1217359) >> 19) + 1;
+}
+
+// floor(log10(2^e)) and floor(log10(5^e))
+static uint32_t log10Pow2(int e) {
+    return ((uint32_t) e * 78913) >> 18;
+}
+
+static uint32_t log10Pow5(int e) {
+    return ((uint32_t) e * 732923) >> 20;
 }
 
-bool lexer_peek_expect(Lexer* l, TokenType expect) {
-    const Token* tk = lexer_peek(l);
-    if (tk == NULL) return false;
-    return tk->type == expect;
+// the tables are computed once from exact big integers, they are the same values Ryu ships as constants
+static void pow5_compute(void) {
+    enum { LIMBS = 27 };  // 32 bit limbs, little endian, 5^341 has 793 bits
+    uint32_t pow5[LIMBS] = { 1 };
+    for (int i = 0; i < POW5_INV_NUM; i++) {
+        int bits = pow5bits(i);
+        if (i < POW5_NUM) {
+            // top POW5_BITCOUNT bits of 5^i
+            uint128 top = 0;
+            for (int b = bits - 1; b >= bits - POW5_BITCOUNT; b--) {
+                top <<= 1;
+                if (b >= 0) top |= pow5[b / 32] >> (b % 32) & 1;
+            }
+            pow5Split[i][0] = (uint64_t) top;
+            pow5Split[i][1] = (uint64_t) (top >> 64);
+        }
+
+        // floor(2^(bits - 1 + POW5_INV_BITCOUNT) / 5^i) + 1 by long division, 2^(bits - 1) <= 5^i so the quotient
+        // bits above POW5_INV_BITCOUNT are zero and the division starts there
+        int limbs = bits / 32 + 2;
+        uint32_t rem[LIMBS] = { 0 };
+        rem[(bits - 1) / 32] = 1u << (bits - 1) % 32;
+        uint128 quot = 0;
+        for (int b = 0; b <= POW5_INV_BITCOUNT; b++) {
+            if (b > 0) {
+                for (int l = limbs - 1; l > 0; l--) rem[l] = rem[l] << 1 | rem[l - 1] >> 31;
+                rem[0] <<= 1;
+            }
+            int cmp = 0;
+            for (int l = limbs - 1; l >= 0 && cmp == 0; l--) {
+                cmp = rem[l] < pow5[l] ? -1 : rem[l] > pow5[l];
+            }
+            quot <<= 1;
+            if (cmp >= 0) {
+                uint64_t borrow = 0;
+                for (int l = 0; l < limbs; l++) {
+                    uint64_t d = (uint64_t) rem[l] - pow5[l] - borrow;
+                    rem[l] = (uint32_t) d;
+                    borrow = d >> 63;
+                }
+                quot |= 1;
+            }
+        }
+        quot += 1;
+        pow5InvSplit[i][0] = (uint64_t) quot;
+        pow5InvSplit[i][1] = (uint64_t) (quot >> 64);
+
+        uint64_t carry = 0;
+        for (int l = 0; l < LIMBS; l++) {
+            uint64_t v = (uint64_t) pow5[l] * 5 + carry;
+            pow5[l] = (uint32_t) v;
+            carry = v >> 32;
+        }
+    }
 }
 
-int lexer_next(Lexer* l) {
-    l->cursor += l->curLen;
-    lexer_peek(l);
-    return l->curLen;
+// parsing never needs the tables, so they are made by the first writer of a double in whichever thread
+static void pow5_init(void) {
+    static int state;  // 0 not computed, 1 computing, 2 ready
+    if (__atomic_load_n(&state, __ATOMIC_ACQUIRE) == 2) return;
+    int expected = 0;
+    if (__atomic_compare_exchange_n(&state, &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+        pow5_compute();
+        __atomic_store_n(&state, 2, __ATOMIC_RELEASE);
+        return;
+    }
+    while (__atomic_load_n(&state, __ATOMIC_ACQUIRE) != 2) {
+    }
 }
 
-static int parse_base_obj(JsonBaseObj* obj, Lexer* l);
+static uint64_t mul_shift64(uint64_t m, const uint64_t* mul, int j) {
+    uint128 b0 = (uint128) m * mul[0];
+    uint128 b2 = (uint128) m * mul[1];
+    return (uint64_t) (((b0 >> 64) + b2) >> (j - 64));
+}
 
-static int parse_null(Lexer* l) {
-    int old = l->cursor;
-    if (!lexer_peek_expect(l, TNUll)) return 0;
-    lexer_next(l);
-    return l->cursor - old;
+static bool multiple_of_pow5(uint64_t v, uint32_t p) {
+    uint32_t count = 0;
+    while (v % 5 == 0) {
+        v /= 5;
+        count++;
+    }
+    return count >= p;
 }
 
-static int parse_num(JsonNum* num, Lexer* l) {
-    int old = l->cursor;
-    if (!lexer_peek_expect(l, TNum)) return 0;
-    const Token* tk = lexer_peek(l);
-    jstr_to_jnum(&tk->content, num);
-    lexer_next(l);
-    return l->cursor - old;
+static bool multiple_of_pow2(uint64_t v, uint32_t p) {
+    return (v & ((1ull << p) - 1)) == 0;
 }
 
-static int parse_bool(JsonBool* jbool, Lexer* l) {
-    int old = l->cursor;
+// a finite nonzero double as digits * 10^exp with the fewest digits
+static uint64_t d2d(uint64_t ieeeMantissa, uint32_t ieeeExponent, int* exp) {
+    int e2;
+    uint64_t m2;
+    if (ieeeExponent == 0) {
+        e2 = 1 - 1023 - 52 - 2;
+        m2 = ieeeMantissa;
+    } else {
+        e2 = (int) ieeeExponent - 1023 - 52 - 2;
+        m2 = (1ull << 52) | ieeeMantissa;
+    }
+    bool acceptBounds = (m2 & 1) == 0;
+
+    // the interval of the double is (mm, mp) around mv, in units of 2^e2
+    uint64_t mv = 4 * m2;
+    uint32_t mmShift = ieeeMantissa != 0 || ieeeExponent <= 1;
+
+    uint64_t vr, vp, vm;
+    int e10;
+    bool vmIsTrailingZeros = false;
+    bool vrIsTrailingZeros = false;
+    if (e2 >= 0) {
+        uint32_t q = log10Pow2(e2) - (e2 > 3);
+        e10 = (int) q;
+        int k = POW5_INV_BITCOUNT + pow5bits((int) q) - 1;
+        int i = -e2 + (int) q + k;
+        vr = mul_shift64(4 * m2, pow5InvSplit[q], i);
+        vp = mul_shift64(4 * m2 + 2, pow5InvSplit[q], i);
+        vm = mul_shift64(4 * m2 - 1 - mmShift, pow5InvSplit[q], i);
+        if (q <= 21) {
+            // only one of mp, mv and mm can be a multiple of 5, if any
+            if (mv % 5 == 0) {
+                vrIsTrailingZeros = multiple_of_pow5(mv, q);
+            } else if (acceptBounds) {
+                vmIsTrailingZeros = multiple_of_pow5(mv - 1 - mmShift, q);
+            } else {
+                vp -= multiple_of_pow5(mv + 2, q);
+            }
+        }
+    } else {
+        uint32_t q = log10Pow5(-e2) - (-e2 > 1);
+        e10 = (int) q + e2;
+        int i = -e2 - (int) q;
+        int k = pow5bits(i) - POW5_BITCOUNT;
+        int j = (int) q - k;
+        vr = mul_shift64(4 * m2, pow5Split[i], j);
+        vp = mul_shift64(4 * m2 + 2, pow5Split[i], j);
+        vm = mul_shift64(4 * m2 - 1 - mmShift, pow5Split[i], j);
+        if (q <= 1) {
+            // mv has at least q trailing zero bits, so vr is exact
+            vrIsTrailingZeros = true;
+            if (acceptBounds) {
+                vmIsTrailingZeros = mmShift == 1;
+            } else {
+                vp--;
+            }
+        } else if (q < 63) {
+            vrIsTrailingZeros = multiple_of_pow2(mv, q);
+        }
+    }
 
-    if (lexer_peek_expect(l, TTrue)) {
-        jbool->data = true;
-    } else if (lexer_peek_expect(l, TFalse)) {
-        jbool->data = false;
+    // drop digits while the interval still holds a shorter number
+    int removed = 0;
+    uint8_t lastRemovedDigit = 0;
+    uint64_t output;
+    if (vmIsTrailingZeros || vrIsTrailingZeros) {
+        // the rare case where the bounds or the value are exact decimals
+        while (vp / 10 > vm / 10) {
+            vmIsTrailingZeros &= vm % 10 == 0;
+            vrIsTrailingZeros &= lastRemovedDigit == 0;
+            lastRemovedDigit = vr % 10;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        if (vmIsTrailingZeros) {
+            while (vm % 10 == 0) {
+                vrIsTrailingZeros &= lastRemovedDigit == 0;
+                lastRemovedDigit = vr % 10;
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                removed++;
+            }
+        }
+        // round half to even when the exact value is ...50..0
+        if (vrIsTrailingZeros && lastRemovedDigit == 5 && vr % 2 == 0) lastRemovedDigit = 4;
+        output = vr + ((vr == vm && (!acceptBounds || !vmIsTrailingZeros)) || lastRemovedDigit >= 5);
     } else {
-        goto fail;
+        bool roundUp = false;
+        if (vp / 100 > vm / 100) {
+            roundUp = vr % 100 >= 50;
+            vr /= 100;
+            vp /= 100;
+            vm /= 100;
+            removed += 2;
+        }
+        while (vp / 10 > vm / 10) {
+            roundUp = vr % 10 >= 5;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        output = vr + (vr == vm || roundUp);
     }
+    *exp = e10 + removed;
+    return output;
+}
 
-    lexer_next(l);
-    return l->cursor - old;
+static const char digitPairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// the decimal digits of v at out, two at a time from the right
+static int format_uint(char* out, uint64_t v) {
+    char tmp[20];
+    int n = sizeof(tmp);
+    while (v >= 100) {
+        n -= 2;
+        memcpy(tmp + n, digitPairs + v % 100 * 2, 2);
+        v /= 100;
+    }
+    if (v >= 10) {
+        n -= 2;
+        memcpy(tmp + n, digitPairs + v * 2, 2);
+    } else {
+        tmp[--n] = '0' + v;
+    }
+    memcpy(out, tmp + n, sizeof(tmp) - n);
+    return sizeof(tmp) - n;
+}
 
-fail:
-    l->cursor = old;
-    lexer_peek(l);
-    return 0;
+static int format_int(char* out, int64_t v) {
+    if (v >= 0) return format_uint(out, v);
+    out[0] = '-';
+    return 1 + format_uint(out + 1, -(uint64_t) v);
 }
 
-static int parse_str(JsonStr* str, Lexer* l) {
-    int old = l->cursor;
-    if (!lexer_peek_expect(l, TStr)) {
-        goto fail;
+// plain notation for 1e-6 <= |v| < 1e21 like JavaScript, a fraction or ".0" marks it as a double to the parser;
+// at most 25 bytes; not a number or infinity has no JSON form and becomes null
+static int format_double(char* out, double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    uint64_t mantissa = bits & ((1ull << 52) - 1);
+    uint32_t exponent = bits >> 52 & 0x7ff;
+    int n = 0;
+    if (exponent == 0x7ff) {
+        memcpy(out, "null", 4);
+        return 4;
+    }
+    if (bits >> 63) out[n++] = '-';
+    if (exponent == 0 && mantissa == 0) {
+        memcpy(out + n, "0.0", 3);
+        return n + 3;
+    }
+
+    pow5_init();
+    int exp;
+    char digits[20];
+    int len = format_uint(digits, d2d(mantissa, exponent, &exp));
+    // the point goes after the first `point` digits
+    int point = len + exp;
+    if (0 < point && point <= 21) {
+        if (len <= point) {
+            memcpy(out + n, digits, len);
+            memset(out + n + len, '0', point - len);
+            n += point;
+            memcpy(out + n, ".0", 2);
+            return n + 2;
+        }
+        memcpy(out + n, digits, point);
+        out[n + point] = '.';
+        memcpy(out + n + point + 1, digits + point, len - point);
+        return n + len + 1;
     }
+    if (-6 < point && point <= 0) {
+        memcpy(out + n, "0.", 2);
+        memset(out + n + 2, '0', -point);
+        n += 2 - point;
+        memcpy(out + n, digits, len);
+        return n + len;
+    }
+    out[n++] = digits[0];
+    if (len > 1) {
+        out[n++] = '.';
+        memcpy(out + n, digits + 1, len - 1);
+        n += len - 1;
+    }
+    out[n++] = 'e';
+    return n + format_int(out + n, point - 1);
+}
 
-    jstr_cpy(str, &lexer_peek(l)->content);
-    lexer_next(l);
+// nothing fits in a failed writer any more, which keeps the fast paths from writing
+static void jw_fail(JsonWriter* w) {
+    w->failed = true;
+    w->cap = w->len;
+}
 
-fail:
-    l->cursor = old;
-    return 0;
+void jwriter_init(JsonWriter* w, char* buf, int cap) {
+    memset(w, 0, sizeof(*w));
+    w->buf = buf;
+    w->cap = cap;
+    w->fd = -1;
+    w->first = true;
 }
 
-static int parse_array(JsonArray* resObj, Lexer* l) {
-    int old = l->cursor;
+void jwriter_init_grow(JsonWriter* w, int cap) {
+    jwriter_init(w, malloc(cap), cap);
+    w->grow = true;
+    if (w->buf == NULL) jw_fail(w);
+}
+
+void jwriter_init_fd(JsonWriter* w, int fd, int chunk) {
+    jwriter_init(w, malloc(chunk), chunk);
+    w->fd = fd;
+    if (w->buf == NULL) jw_fail(w);
+}
 
-fail:
-    l->cursor = old;
-    lexer_peek(l);
+void jwriter_free(JsonWriter* w) {
+    if (w->grow || w->fd >= 0) free(w->buf);
+    w->buf = NULL;
+}
+
+static int write_all(int fd, const char* data, int len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        data += n;
+        len -= n;
+    }
     return 0;
 }
 
-static int parse_obj_field(JsonMap* resObj, Lexer* l) {
-    int old = l->cursor;
-    JsonStr strObj;
-    JsonBaseObj fieldObj;
+int jwriter_flush(JsonWriter* w) {
+    if (w->failed) return -1;
+    if (w->fd >= 0 && w->len > 0) {
+        int failed = write_all(w->fd, w->buf, w->len);
+        w->len = 0;
+        if (failed) jw_fail(w);
+    }
+    return w->failed ? -1 : 0;
+}
 
-    if (!lexer_peek_expect(l, TStr)) goto fail;
-    Token temp;
-    lexer_next(l);
-    strObj = temp.content;
+// room for n more bytes, NULL once the writer has failed
+static char* jw_reserve(JsonWriter* w, int n) {
+    if (w->failed) return NULL;
+    if (w->len + n <= w->cap) return w->buf + w->len;
+    if (w->fd >= 0) {
+        if (jwriter_flush(w) != 0) return NULL;
+        if (n <= w->cap) return w->buf;
+    } else if (w->grow) {
+        int cap = w->cap * 2;
+        while (cap < w->len + n) cap *= 2;
+        char* buf = realloc(w->buf, cap);
+        if (buf != NULL) {
+            w->buf = buf;
+            w->cap = cap;
+            return buf + w->len;
+        }
+    }
+    jw_fail(w);
+    return NULL;
+}
 
-    if (!lexer_peek_expect(l, TColon)) goto fail;
-    lexer_next(l);
+static void jw_put(JsonWriter* w, const char* data, int n) {
+    if (w->len + n <= w->cap) {
+        memcpy(w->buf + w->len, data, n);
+        w->len += n;
+        return;
+    }
+    // a run longer than the chunk of a file descriptor writer goes out directly
+    if (w->fd >= 0 && n > w->cap) {
+        if (jwriter_flush(w) == 0 && write_all(w->fd, data, n) != 0) jw_fail(w);
+        return;
+    }
+    char* out = jw_reserve(w, n);
+    if (out == NULL) return;
+    memcpy(out, data, n);
+    w->len += n;
+}
 
-    if (parse_base_obj(&fieldObj, l) == 0) goto fail;
+static inline void jw_byte(JsonWriter* w, char c) {
+    if (w->len < w->cap) {
+        w->buf[w->len++] = c;
+        return;
+    }
+    char* out = jw_reserve(w, 1);
+    if (out == NULL) return;
+    *out = c;
+    w->len++;
+}
 
-    return l->cursor - old;
+// the byte that follows the backslash, 'u' for \u00XX, 0 for bytes written as they are
+static const char escapeChar[256] = {
+    [0 ... 0x1f] = 'u', ['\b'] = 'b', ['\f'] = 'f', ['\n'] = 'n', ['\r'] = 'r',
+    ['\t'] = 't',      ['"'] = '"',  ['\\'] = '\\',
+};
+
+static void jw_quoted(JsonWriter* w, const char* s, int len) {
+    // most strings need no escape and fit, they are copied while they are checked
+    if (w->len + len + 2 <= w->cap) {
+        char* out = w->buf + w->len;
+        int i = 0;
+        while (i < len && escapeChar[(unsigned char) s[i]] == 0) {
+            out[i + 1] = s[i];
+            i++;
+        }
+        if (i == len) {
+            out[0] = '"';
+            out[len + 1] = '"';
+            w->len += len + 2;
+            return;
+        }
+    }
 
-fail:
-    l->cursor = old;
-    lexer_peek(l);
-    return 0;
+    jw_byte(w, '"');
+    int run = 0;
+    for (int i = 0; i < len; i++) {
+        char e = escapeChar[(unsigned char) s[i]];
+        if (e == 0) continue;
+        jw_put(w, s + run, i - run);
+        run = i + 1;
+        char esc[6] = { '\\', e };
+        if (e != 'u') {
+            jw_put(w, esc, 2);
+        } else {
+            memcpy(esc + 2, "00", 2);
+            esc[4] = "0123456789abcdef"[(unsigned char) s[i] >> 4];
+            esc[5] = "0123456789abcdef"[s[i] & 0xf];
+            jw_put(w, esc, 6);
+        }
+    }
+    jw_put(w, s + run, len - run);
+    jw_byte(w, '"');
 }
 
-static int init_json_map(JsonMap* map) {
-    JsonMap temp = { .cap = 0, .len = 0, .keyList = NULL, .valueList = NULL };
-    *map = temp;
-    return 0;
+// the comma before an element, none before the first one or after a key
+static void jw_sep(JsonWriter* w) {
+    if (!w->first && !w->afterKey) jw_byte(w, ',');
+    w->first = false;
+    w->afterKey = false;
 }
 
-static int parse_map(JsonMap* resObj, Lexer* l) {
-    int old = l->cursor;
-    JsonMap obj;
-    init_json_map(&obj);
+void jwriter_begin_object(JsonWriter* w) {
+    jw_sep(w);
+    jw_byte(w, '{');
+    w->first = true;
+}
 
-    if (!lexer_peek_expect(l, TLBrace)) goto fail;
+void jwriter_end_object(JsonWriter* w) {
+    jw_byte(w, '}');
+    w->first = false;
+}
 
-    lexer_next(l);
-    while (parse_obj_field(&obj, l) != 0)
-        ;
+void jwriter_begin_array(JsonWriter* w) {
+    jw_sep(w);
+    jw_byte(w, '[');
+    w->first = true;
+}
 
-    if (!lexer_peek_expect(l, TRBrace)) goto fail;
+void jwriter_end_array(JsonWriter* w) {
+    jw_byte(w, ']');
+    w->first = false;
+}
 
-    lexer_next(l);
-    return l->cursor - old;
+void jwriter_key(JsonWriter* w, const char* key, int len) {
+    jw_sep(w);
+    jw_quoted(w, key, len);
+    jw_byte(w, ':');
+    w->afterKey = true;
+}
 
-fail:
-    l->cursor = old;
-    lexer_peek(l);
-    return 0;
+void jwriter_str(JsonWriter* w, const char* s, int len) {
+    jw_sep(w);
+    jw_quoted(w, s, len);
 }
 
-static int parse_base_obj(JsonBaseObj* obj, Lexer* l) {
-    int offset = 0;
+void jwriter_int(JsonWriter* w, int64_t v) {
+    jw_sep(w);
+    char tmp[20];
+    jw_put(w, tmp, format_int(tmp, v));
+}
 
-    offset = parse_map(&obj->jsonMap, l);
-    if (offset != 0) {
-        obj->type = JMap;
-        return offset;
-    }
+void jwriter_double(JsonWriter* w, double v) {
+    jw_sep(w);
+    char tmp[32];
+    jw_put(w, tmp, format_double(tmp, v));
+}
 
-    offset = parse_array(&obj->jsonArray, l);
-    if (offset != 0) {
-        obj->type = JArray;
-        return offset;
-    }
+void jwriter_bool(JsonWriter* w, bool v) {
+    jw_sep(w);
+    jw_put(w, v ? "true" : "false", v ? 4 : 5);
+}
 
-    offset = parse_str(&obj->jsonStr, l);
-    if (offset != 0) {
-        obj->type = JStr;
-        return offset;
-    }
+void jwriter_null(JsonWriter* w) {
+    jw_sep(w);
+    jw_put(w, "null", 4);
+}
 
-    offset = parse_num(&obj->jsonNum, l);
-    if (offset != 0) {
-        obj->type = JNum;
-        return offset;
+static void jw_jstr(JsonWriter* w, const JsonStr* str) {
+    // an escaped view is still the JSON text it was parsed from
+    if (str->cap != JSTR_ESCAPED) {
+        jw_quoted(w, str->data, str->len);
+        return;
     }
+    jw_byte(w, '"');
+    jw_put(w, str->data, str->len);
+    jw_byte(w, '"');
+}
 
-    offset = parse_bool(&obj->jsonBool, l);
-    if (offset != 0) {
-        obj->type = JBool;
-        return offset;
+int jwriter_value(JsonWriter* w, const JsonBaseObj* obj) {
+    switch (obj->type) {
+    case JNull:
+        jwriter_null(w);
+        break;
+    case JBool:
+        jwriter_bool(w, obj->jsonBool.data);
+        break;
+    case JNum:
+        if (obj->jsonNum.isInt) {
+            jwriter_int(w, obj->jsonNum.Int64);
+        } else {
+            jwriter_double(w, obj->jsonNum.Double);
+        }
+        break;
+    case JStr:
+        jw_sep(w);
+        jw_jstr(w, &obj->jsonStr);
+        break;
+    case JArray:
+        jwriter_begin_array(w);
+        for (int i = 0; i < obj->jsonArray.length && !w->failed; i++) {
+            jwriter_value(w, &obj->jsonArray.list[i]);
+        }
+        jwriter_end_array(w);
+        break;
+    case JMap:
+        jwriter_begin_object(w);
+        for (int i = 0; i < obj->jsonMap.len && !w->failed; i++) {
+            jw_sep(w);
+            jw_jstr(w, &obj->jsonMap.keyList[i]);
+            jw_byte(w, ':');
+            w->afterKey = true;
+            jwriter_value(w, &obj->jsonMap.valueList[i]);
+        }
+        jwriter_end_object(w);
+        break;
     }
+    return w->failed ? -1 : 0;
+}
 
-    offset = parse_null(l);
-    if (offset != 0) {
-        obj->type = JNull;
-        return offset;
+char* minijson_to_str(const JsonBaseObj* obj, int* len) {
+    JsonWriter w;
+    jwriter_init_grow(&w, 256);
+    jwriter_value(&w, obj);
+    jw_byte(&w, '\0');
+    if (w.failed) {
+        jwriter_free(&w);
+        return NULL;
     }
-
-    return 0;
+    if (len != NULL) *len = w.len - 1;
+    return w.buf;
 }
 
 const char* minijson_version() {
-    return "0.0.1";
+    return "0.0.2";
 }
-JsonMap* minijson_parse_str();
-void minijson_to_str();
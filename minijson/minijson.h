@@ -1,5 +1,6 @@
 #pragma once
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 typedef enum {
@@ -21,25 +22,35 @@ typedef struct {
     double Double;
 } JsonNum;
 
-typedef struct {
+// cap > 0: the document owns data, which is NUL terminated
+// cap == JSTR_VIEW: data points into the parsed input and has no terminator
+// cap == JSTR_ESCAPED: a view that still holds escapes, len is the raw length until jstr_resolve
+#define JSTR_VIEW 0
+#define JSTR_ESCAPED (-1)
+
+typedef struct JsonStr {
     int len;
     int cap;
     char* data;
 } JsonStr;
 
-typedef struct {
+typedef struct JsonArray {
     int length;
     struct JsonBaseObj* list;
 } JsonArray;
 
-typedef struct {
+// a parsed map with 16 keys or more has a hash index, indexMask + 1 slots of key position + 1 or 0 when empty;
+// a map built by hand leaves index NULL and is searched in order
+typedef struct JsonMap {
     int len;
     int cap;
     struct JsonStr* keyList;
     struct JsonBaseObj* valueList;
+    uint32_t* index;
+    uint32_t indexMask;
 } JsonMap;
 
-typedef struct {
+typedef struct JsonBaseObj {
     JsonObjType type;
     union {
         JsonBool jsonBool;
@@ -50,6 +61,110 @@ typedef struct {
     };
 } JsonBaseObj;
 
+// a bump allocator, everything of a document lives in its blocks and is freed at once
+typedef struct JsonArenaBlock JsonArenaBlock;
+typedef struct {
+    JsonArenaBlock* head;
+} JsonArena;
+
+typedef struct {
+    JsonArena arena;
+    JsonBaseObj root;
+} JsonDoc;
+
+void* jarena_alloc(JsonArena* arena, size_t size);
+void jarena_free(JsonArena* arena);
+
 const char* minijson_version();
-JsonMap* minijson_parse_str();
-void minijson_to_str();
+
+// how the parser finds the structural characters, 64 bytes at a time with the widest instructions the cpu has by
+// default; set it before parsing, it is shared by all threads
+typedef enum {
+    JsonScanAuto,
+    JsonScanScalar,
+    JsonScanSse2,
+    JsonScanAvx2,
+} JsonScanKind;
+
+// returns the kind in effect, which is the best supported one when the asked one is not
+JsonScanKind minijson_set_scan(JsonScanKind kind);
+
+// parse len bytes of str, errPos (may be NULL) gets the offset of the first error when NULL is returned
+JsonDoc* minijson_parse_str(const char* str, int len, int* errPos);
+// like minijson_parse_str, but the strings are views into str, which must outlive the document; keys are resolved
+// while parsing, values with escapes are unescaped on their first jstr_resolve
+JsonDoc* minijson_parse_view(const char* str, int len, int* errPos);
+void minijson_free(JsonDoc* doc);
+
+// where the serializer writes: a fixed buffer, a heap buffer that grows, or a chunk buffer flushed to a file
+// descriptor whenever it is full; any failure is sticky and the writer then drops the rest of the output
+typedef struct {
+    char* buf;
+    int len;
+    int cap;
+    int fd;  // >= 0 for a file descriptor writer
+    bool grow;
+    bool failed;
+    // the separator state of the event functions, no stack is needed
+    bool first;
+    bool afterKey;
+} JsonWriter;
+
+void jwriter_init(JsonWriter* w, char* buf, int cap);
+void jwriter_init_grow(JsonWriter* w, int cap);
+void jwriter_init_fd(JsonWriter* w, int fd, int chunk);
+// writes the chunk of a file descriptor writer out, -1 if anything failed since init
+int jwriter_flush(JsonWriter* w);
+void jwriter_free(JsonWriter* w);
+
+// a whole value, -1 if the writer failed
+int jwriter_value(JsonWriter* w, const JsonBaseObj* obj);
+// a document piece by piece, commas and colons are placed by the writer
+void jwriter_begin_object(JsonWriter* w);
+void jwriter_end_object(JsonWriter* w);
+void jwriter_begin_array(JsonWriter* w);
+void jwriter_end_array(JsonWriter* w);
+void jwriter_key(JsonWriter* w, const char* key, int len);
+void jwriter_str(JsonWriter* w, const char* s, int len);
+void jwriter_int(JsonWriter* w, int64_t v);
+// the shortest text that reads back as exactly v
+void jwriter_double(JsonWriter* w, double v);
+void jwriter_bool(JsonWriter* w, bool v);
+void jwriter_null(JsonWriter* w);
+
+// obj as compact JSON in a malloc'ed NUL terminated string, len (may be NULL) gets its length
+char* minijson_to_str(const JsonBaseObj* obj, int* len);
+
+// events of the streaming parser, every callback may be NULL and a nonzero return stops the parse as an error
+typedef struct {
+    void* ctx;
+    int (*beginObject)(void* ctx);
+    int (*endObject)(void* ctx);
+    int (*beginArray)(void* ctx);
+    int (*endArray)(void* ctx);
+    // the key is unescaped, data is only valid during the call and may not be NUL terminated
+    int (*key)(void* ctx, const char* data, int len);
+    // a null, bool, number or string; a string is a JSTR_VIEW that is only valid during the call
+    int (*value)(void* ctx, const JsonBaseObj* value);
+    // a top level value is complete, the stream may hold any number of them, e.g. JSON lines
+    int (*endDocument)(void* ctx);
+} JsonSaxHandler;
+
+// a push parser fed with chunks cut anywhere, its memory grows with the nesting depth and the longest token only
+typedef struct JsonSax JsonSax;
+JsonSax* minijson_sax_new(const JsonSaxHandler* handler);
+// -1 on a syntax error or a failed callback, the parser then refuses more input
+int minijson_sax_feed(JsonSax* sax, const char* data, int len);
+// the stream ended, -1 when it stopped inside a value
+int minijson_sax_finish(JsonSax* sax);
+// stream offset of the error after a failed call
+int64_t minijson_sax_errpos(const JsonSax* sax);
+void minijson_sax_free(JsonSax* sax);
+
+// the value of the first key equal to the len bytes of key, NULL if there is none
+JsonBaseObj* minijson_map_get(const JsonMap* map, const char* key, int len);
+
+// only for strings that own their data
+const char* jstr_cstr(const JsonStr* str);
+// the bytes of a string of doc, after it len is the unescaped length; NULL when out of memory
+const char* jstr_resolve(JsonDoc* doc, JsonStr* str);
@@ -0,0 +1,306 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "chess.h"
+#include "search.h"
+#include "shmring.h"
+#include "snapshot.h"
+#include "tablebase.h"
+
+static void place(GameState* game, const char* sq, Piece p, Team t) {
+    Elem* e = &game->board[(sq[0] - 'a') + 8 * (sq[1] - '1')];
+    e->isEmpty = false;
+    e->piece = p;
+    e->team = t;
+}
+
+static void clear_board(GameState* game, Team turn) {
+    InitGame(game);
+    for (int i = 0; i < 64; i++) {
+        game->board[i].isEmpty = true;
+    }
+    game->turn = turn;
+}
+
+static void test_tablebase() {
+    Tablebase kqk;
+    assert(Tablebase_generate(&kqk, "KQK", 2) == 0);
+    // the longest KQK mate takes 10 moves, black to move loses in 20 plies
+    assert(kqk.maxDtm == 20);
+    assert(Tablebase_register(&kqk) == 0);
+
+    static GameState game;
+    TbResult res;
+
+    // black is mated
+    clear_board(&game, Black);
+    place(&game, "a8", King, Black);
+    place(&game, "b7", Queen, White);
+    place(&game, "c6", King, White);
+    assert(Tablebase_probe(&game, &res));
+    assert(res.value == TbLoss && res.dtm == 0);
+
+    // mate in one for white, and the mirrored colors
+    clear_board(&game, White);
+    place(&game, "a8", King, Black);
+    place(&game, "b1", Queen, White);
+    place(&game, "c6", King, White);
+    assert(Tablebase_probe(&game, &res));
+    assert(res.value == TbWin && res.dtm == 1);
+    Step step;
+    assert(Tablebase_bestStep(&game, &step));
+    assert(Game_exec(&game, "b1b7") == Success);
+    assert(game.isFinished && game.winner == White);
+
+    clear_board(&game, Black);
+    place(&game, "a1", King, White);
+    place(&game, "b8", Queen, Black);
+    place(&game, "c3", King, Black);
+    assert(Tablebase_probe(&game, &res));
+    assert(res.value == TbWin && res.dtm == 1);
+
+    // the queen hangs, the game ends in a draw once it is taken
+    clear_board(&game, Black);
+    place(&game, "a8", King, Black);
+    place(&game, "b7", Queen, White);
+    place(&game, "h1", King, White);
+    assert(Tablebase_probe(&game, &res));
+    assert(res.value == TbDraw);
+    assert(Game_exec(&game, "a8b7") == Success);
+    assert(game.isFinished && game.winner == NoTeam);
+
+    assert(Tablebase_save(&kqk, "test_kqk.mctb") == 0);
+    Tablebase loaded;
+    assert(Tablebase_load(&loaded, "test_kqk.mctb") == 0);
+    assert(loaded.size == kqk.size && loaded.maxDtm == kqk.maxDtm);
+    for (uint64_t i = 0; i < kqk.size; i += 997) {
+        TbResult a = Tablebase_get(&kqk, i);
+        TbResult b = Tablebase_get(&loaded, i);
+        assert(a.value == b.value && a.dtm == b.dtm);
+    }
+    remove("test_kqk.mctb");
+
+    Tablebase_unregisterAll();
+    Tablebase_free(&loaded);
+    Tablebase_free(&kqk);
+
+    Tablebase kbk;
+    assert(Tablebase_generate(&kbk, "KBK", 1) == 0);
+    assert(kbk.maxDtm == 0);
+    Tablebase_free(&kbk);
+}
+
+static void test_search() {
+    static GameState game;
+    clear_board(&game, White);
+    place(&game, "a8", King, Black);
+    place(&game, "b1", Queen, White);
+    place(&game, "c6", King, White);
+    place(&game, "h2", Pawn, Black);
+
+    SearchConfig cfg = { .depth = 2 };
+    SearchResult res;
+    Search_run(&game, &cfg, &res);
+    assert(res.hasMove && res.score == SEARCH_MATE - 1);
+
+    char move[5];
+    Step_tostr(&res.best, move);
+    assert(Game_exec(&game, move) == Success);
+    assert(game.isFinished && game.winner == White);
+    assert(game.stepNum == 1 && game.history[0].isCheckMate);
+    assert(Game_exec(&game, "h2h1") == ErrAlreadyFinish);
+}
+
+static void test_fen() {
+    static GameState game;
+    char fen[100];
+    InitGame(&game);
+    Game_toFen(&game, fen, sizeof(fen));
+    assert(strcmp(fen, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w - - 0 1") == 0);
+
+    assert(Game_fromFen(&game, "4k3/8/8/8/8/8/8/4K2R b KQ - 0 1") == 0);
+    assert(game.turn == Black && !game.board[7].isEmpty && game.board[7].piece == Rook);
+    Game_toFen(&game, fen, sizeof(fen));
+    assert(strcmp(fen, "4k3/8/8/8/8/8/8/4K2R b - - 0 1") == 0);
+
+    assert(Game_fromFen(&game, "4k3/8/8/8/8/8/8/4K2X w") != 0);
+    assert(Game_fromFen(&game, "4k3/8/8/8/8/8/4K2R w") != 0);
+    assert(Game_fromFen(&game, "4k3/8/8/8/8/8/8/4K2R wx") != 0);
+    assert(Game_fromFen(&game, "4k3/8/8/8/8/8/8/4K2R x") != 0);
+    assert(Game_fromFen(&game, "4k3/8/8/8/8/8/8/4K2R") != 0);
+    assert(Game_fromFen(&game, "4k3/8/8/8/8/8/8/4K2R w") == 0 && game.turn == White);
+}
+
+static void assert_same_game(const GameState* a, const GameState* b) {
+    assert(a->turn == b->turn && a->stepNum == b->stepNum);
+    assert(a->isFinished == b->isFinished && a->winner == b->winner);
+    for (int i = 0; i < 64; i++) {
+        const Elem* x = &a->board[i];
+        const Elem* y = &b->board[i];
+        assert(x->isEmpty == y->isEmpty && (x->isEmpty || (x->piece == y->piece && x->team == y->team)));
+    }
+    for (int i = 0; i < a->stepNum; i++) {
+        const Step* x = &a->history[i];
+        const Step* y = &b->history[i];
+        assert(x->from.x == y->from.x && x->from.y == y->from.y && x->to.x == y->to.x && x->to.y == y->to.y);
+        assert(x->p == y->p && x->turn == y->turn && x->isEat == y->isEat && x->isCheckMate == y->isCheckMate);
+        assert(!x->isEat || x->died == y->died);
+    }
+}
+
+static JsonDoc* snapshot(const GameState* game, int since) {
+    JsonWriter w;
+    jwriter_init_grow(&w, 256);
+    assert((since < 0 ? Snapshot_write(game, &w) : Snapshot_writeDelta(game, since, &w)) == 0);
+    JsonDoc* doc = minijson_parse_str(w.buf, w.len, NULL);
+    assert(doc != NULL);
+    jwriter_free(&w);
+    return doc;
+}
+
+static void test_snapshot() {
+    static GameState game, restored;
+    InitGame(&game);
+    assert(Game_exec(&game, "e2e4") == Success);
+    char buf[256];
+    JsonWriter w;
+    jwriter_init(&w, buf, sizeof(buf));
+    assert(Snapshot_write(&game, &w) == 0);
+    const char* want = "{\"ply\":1,\"turn\":\"black\",\"finished\":false,\"winner\":\"none\",\"moves\":[\"Pe2e4\"],"
+                       "\"fen\":\"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b - - 0 1\"}";
+    assert(w.len == (int) strlen(want) && memcmp(buf, want, w.len) == 0);
+
+    const char* moves[] = { "e7e5", "g1f3", "b8c6", "f1c4", "g8f6", "f3e5", "c6e5" };
+    for (int i = 0; i < 3; i++) assert(Game_exec(&game, moves[i]) == Success);
+    JsonDoc* early = snapshot(&game, -1);
+    for (int i = 3; i < 7; i++) assert(Game_exec(&game, moves[i]) == Success);
+
+    JsonDoc* full = snapshot(&game, -1);
+    assert(Snapshot_restore(&restored, &full->root) == 0);
+    assert_same_game(&game, &restored);
+    assert(restored.history[7].isEat && restored.history[7].died == Knight);
+
+    // the earlier snapshot and the moves since then give the same game
+    JsonDoc* delta = snapshot(&game, 4);
+    assert(Snapshot_restore(&restored, &early->root) == 0 && restored.stepNum == 4);
+    assert(Snapshot_applyDelta(&restored, &delta->root) == 0);
+    assert_same_game(&game, &restored);
+    // a delta from another ply is refused and changes nothing
+    assert(Snapshot_applyDelta(&restored, &delta->root) != 0 && restored.stepNum == 8);
+    // since 8.5 is not ply 8, it is refused like a fractional ply
+    const char* fractionSrc = "{\"since\":8.5,\"ply\":8,\"turn\":\"white\",\"finished\":false,"
+                              "\"winner\":\"none\",\"moves\":[]}";
+    JsonDoc* fraction = minijson_parse_str(fractionSrc, strlen(fractionSrc), NULL);
+    assert(fraction != NULL && Snapshot_applyDelta(&restored, &fraction->root) != 0);
+    minijson_free(fraction);
+    assert(Game_exec(&restored, "d2d4") == Success);
+
+    // a move that does not fit the board is refused before anything is applied
+    JsonMap* m = &delta->root.jsonMap;
+    JsonArray* list = &minijson_map_get(m, "moves", 5)->jsonArray;
+    list->list[1].jsonStr.data = "Qg8f6";
+    assert(Snapshot_restore(&restored, &early->root) == 0);
+    assert(Snapshot_applyDelta(&restored, &delta->root) != 0 && restored.stepNum == 4 && restored.turn == White);
+    // a snapshot with a bad move is refused the same way, the game keeps its board and history
+    list = &minijson_map_get(&full->root.jsonMap, "moves", 5)->jsonArray;
+    list->list[5].jsonStr.data = "Zg8f6";
+    assert(Snapshot_restore(&restored, &full->root) != 0);
+    assert(Snapshot_restore(&game, &early->root) == 0);
+    assert_same_game(&game, &restored);
+    minijson_free(delta);
+    minijson_free(full);
+    minijson_free(early);
+
+    // the mate and the result survive the round trip
+    assert(Game_fromFen(&game, "k7/8/2K5/8/8/8/8/1Q6 w") == 0);
+    assert(Game_exec(&game, "b1b7") == Success && game.isFinished);
+    full = snapshot(&game, -1);
+    assert(Snapshot_restore(&restored, &full->root) == 0);
+    assert_same_game(&game, &restored);
+    assert(restored.history[0].isCheckMate && restored.winner == White);
+    minijson_free(full);
+}
+
+// a position whose parts all follow from n, a torn copy mixes two of them
+static void fake_position(GameState* game, int n) {
+    game->stepNum = n;
+    game->turn = n & 1 ? Black : White;
+    for (int i = 0; i < 64; i++) {
+        Elem* e = &game->board[i];
+        e->isEmpty = i >= n % 65;
+        e->piece = Pawn;
+        e->team = game->turn;
+    }
+}
+
+static bool consistent(const ShmPosition* pos) {
+    char want = pos->ply & 1 ? 'p' : 'P';
+    for (int i = 0; i < 64; i++) {
+        if (pos->board[i] != (i < pos->ply % 65 ? want : '.')) return false;
+    }
+    return pos->turn == (pos->ply & 1 ? Black : White) && pos->version == (uint64_t) pos->ply;
+}
+
+static void test_shmring() {
+    char name[64];
+    snprintf(name, sizeof(name), "/minichess_test_%d", (int) getpid());
+    ShmRing writer, reader;
+    assert(ShmRing_create(&writer, name, 4) == 0);
+    assert(ShmRing_open(&reader, name) == 0);
+    ShmPosition pos;
+    assert(!ShmRing_latest(&reader, &pos));
+
+    static GameState game;
+    InitGame(&game);
+    ShmRing_publish(&writer, &game);
+    assert(ShmRing_latest(&reader, &pos) && pos.version == 0 && pos.ply == 0 && pos.moveNum == 0);
+    assert(memcmp(pos.board, "RNBQKBNRPPPPPPPP........", 24) == 0 && pos.board[60] == 'k');
+
+    const char* moves[] = { "e2e4", "e7e5", "g1f3", "b8c6", "f1c4", "g8f6" };
+    for (int i = 0; i < 6; i++) {
+        assert(Game_exec(&game, moves[i]) == Success);
+        ShmRing_publish(&writer, &game);
+    }
+    // four slots keep the last four versions
+    assert(ShmRing_version(&reader) == 7);
+    assert(!ShmRing_get(&reader, 2, &pos) && !ShmRing_get(&reader, 7, &pos));
+    assert(ShmRing_get(&reader, 3, &pos) && pos.ply == 3 && pos.moveNum == 3 && memcmp(pos.moves[2], "g1f3", 4) == 0);
+    assert(ShmRing_latest(&reader, &pos) && pos.ply == 6 && pos.turn == White && pos.board[4 + 8 * 3] == 'P');
+    ShmRing_close(&reader);
+    ShmRing_close(&writer);
+    assert(ShmRing_open(&reader, name) != 0);
+
+    // a reader process never sees a torn position while the writer goes on without waiting for it
+    const int publishes = 200000;
+    assert(ShmRing_create(&writer, name, 8) == 0);
+    pid_t child = fork();
+    if (child == 0) {
+        if (ShmRing_open(&reader, name) != 0) _exit(2);
+        uint64_t last = 0;
+        while (last + 1 < (uint64_t) publishes) {
+            if (!ShmRing_latest(&reader, &pos)) continue;
+            if (!consistent(&pos) || pos.version < last) _exit(1);
+            last = pos.version;
+        }
+        _exit(0);
+    }
+    for (int i = 0; i < publishes; i++) {
+        fake_position(&game, i);
+        ShmRing_publish(&writer, &game);
+    }
+    int status;
+    assert(waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    ShmRing_close(&writer);
+}
+
+int main() {
+    test_fen();
+    test_tablebase();
+    test_search();
+    test_snapshot();
+    test_shmring();
+    printf("chess_test passed\n");
+    return 0;
+}
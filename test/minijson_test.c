@@ -1,6 +1,281 @@
-#include "minijson.h"
+#include <assert.h>
 #include <stdio.h>
-int main(){
-    printf("%s\n",minijson_version());
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "minijson.h"
+
+static JsonDoc* parse(const char* str) {
+    return minijson_parse_str(str, strlen(str), NULL);
+}
+
+static void test_values() {
+    JsonDoc* doc = parse(" {\"a\": [1, -2.5e1, true, false, null], \"b\": {\"c\": \"d\"}, \"e\": []} ");
+    assert(doc != NULL);
+    JsonBaseObj* root = &doc->root;
+    assert(root->type == JMap && root->jsonMap.len == 3);
+    assert(strcmp(jstr_cstr(&root->jsonMap.keyList[0]), "a") == 0);
+
+    JsonArray* a = &root->jsonMap.valueList[0].jsonArray;
+    assert(a->length == 5);
+    assert(a->list[0].type == JNum && a->list[0].jsonNum.isInt && a->list[0].jsonNum.Int64 == 1);
+    assert(a->list[1].type == JNum && !a->list[1].jsonNum.isInt && a->list[1].jsonNum.Double == -25.0);
+    assert(a->list[2].type == JBool && a->list[2].jsonBool.data);
+    assert(a->list[3].type == JBool && !a->list[3].jsonBool.data);
+    assert(a->list[4].type == JNull);
+
+    JsonMap* b = &root->jsonMap.valueList[1].jsonMap;
+    assert(b->len == 1 && strcmp(jstr_cstr(&b->valueList[0].jsonStr), "d") == 0);
+    assert(root->jsonMap.valueList[2].type == JArray && root->jsonMap.valueList[2].jsonArray.length == 0);
+    minijson_free(doc);
+
+    // a double out of the int64 range clamps its integer view
+    doc = parse("[1e30, -1e30, 9223372036854775808.0]");
+    assert(doc != NULL);
+    JsonBaseObj* big = doc->root.jsonArray.list;
+    assert(big[0].jsonNum.Int64 == INT64_MAX && big[1].jsonNum.Int64 == INT64_MIN && big[2].jsonNum.Int64 == INT64_MAX);
+    minijson_free(doc);
+}
+
+static void test_strings() {
+    JsonDoc* doc = parse("[\"a\\\"b\\\\c\\n\", \"\\u00e9\\ud83d\\ude00\", \"\"]");
+    assert(doc != NULL);
+    JsonArray* a = &doc->root.jsonArray;
+    assert(strcmp(jstr_cstr(&a->list[0].jsonStr), "a\"b\\c\n") == 0);
+    assert(strcmp(jstr_cstr(&a->list[1].jsonStr), "\xc3\xa9\xf0\x9f\x98\x80") == 0);
+    assert(a->list[2].jsonStr.len == 0);
+    minijson_free(doc);
+}
+
+static void test_errors() {
+    const char* bad[] = { "", "{", "[1,]", "{\"a\" 1}", "[01]", "tru", "nulls", "\"abc", "[1] 2", "{1: 2}", "\"\\x\"" };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        int pos = -1;
+        assert(minijson_parse_str(bad[i], strlen(bad[i]), &pos) == NULL);
+        assert(pos >= 0);
+    }
+
+    // the error points at the bad token, not at the end of the input
+    int pos = -1;
+    const char* badLiteral = "{\"a\": [true, fals]}";
+    assert(minijson_parse_str("[1, 2, @, 3]", 12, &pos) == NULL);
+    assert(pos == 7);
+    assert(minijson_parse_str(badLiteral, strlen(badLiteral), &pos) == NULL);
+    assert(pos == 13);
+
+    // only len bytes are read, the input needs no terminator
+    JsonDoc* doc = minijson_parse_str("123456", 3, NULL);
+    assert(doc != NULL && doc->root.jsonNum.Int64 == 123);
+    minijson_free(doc);
+}
+
+static void test_views() {
+    const char* src = "{\"plain\": \"abc\", \"k\\u0065y\": \"a\\nb\", \"n\": 1}";
+    JsonDoc* doc = minijson_parse_view(src, strlen(src), NULL);
+    assert(doc != NULL);
+    JsonMap* m = &doc->root.jsonMap;
+
+    // no copy for a plain string, it points into the input
+    JsonStr* plain = &m->valueList[0].jsonStr;
+    assert(plain->cap == JSTR_VIEW && plain->data == src + 11 && plain->len == 3);
+    assert(jstr_resolve(doc, plain) == src + 11);
+
+    // the escaped key is resolved at once, the escaped value on first access
+    assert(m->keyList[1].len == 3 && strcmp(jstr_cstr(&m->keyList[1]), "key") == 0);
+    JsonStr* esc = &m->valueList[1].jsonStr;
+    assert(esc->cap == JSTR_ESCAPED && esc->len == 4);
+    assert(strcmp(jstr_resolve(doc, esc), "a\nb") == 0 && esc->len == 3 && esc->cap > 0);
+    minijson_free(doc);
+
+    // escapes are still checked while parsing
+    assert(minijson_parse_view("[\"\\x\"]", 6, NULL) == NULL);
+}
+
+static void test_map_get() {
+    // small maps are searched in order, large ones through the index
+    for (int keys = 1; keys <= 200; keys += 199) {
+        char src[8192];
+        int n = sprintf(src, "{");
+        for (int i = 0; i < keys; i++) n += sprintf(src + n, "%s\"key%d\": %d", i ? ", " : "", i, i);
+        n += sprintf(src + n, ", \"key0\": -1}");
+        for (int view = 0; view < 2; view++) {
+            JsonDoc* doc = view ? minijson_parse_view(src, n, NULL) : minijson_parse_str(src, n, NULL);
+            assert(doc != NULL);
+            JsonMap* m = &doc->root.jsonMap;
+            assert((m->index != NULL) == (keys > 16));
+            for (int i = 0; i < keys; i++) {
+                char key[16];
+                JsonBaseObj* v = minijson_map_get(m, key, sprintf(key, "key%d", i));
+                assert(v != NULL && v->jsonNum.Int64 == i);
+            }
+            // the first of duplicate keys wins, a prefix is not a match
+            assert(minijson_map_get(m, "key0", 4)->jsonNum.Int64 == 0);
+            assert(minijson_map_get(m, "key", 3) == NULL && minijson_map_get(m, "nokey", 5) == NULL);
+            minijson_free(doc);
+        }
+    }
+}
+
+static void test_write() {
+    // parse and write back gives the compact form of the input
+    const char* src = "{\"a\": [1, -9223372036854775808, 0.1, 1e300, 2.5e-7, 100.0, true, null],\n"
+                      " \"s\": \"q\\\"\\\\\\n\\u0001\u00e9\", \"e\": {}, \"l\": []}";
+    const char* want = "{\"a\":[1,-9223372036854775808,0.1,1e300,2.5e-7,100.0,true,null],"
+                       "\"s\":\"q\\\"\\\\\\n\\u0001\u00e9\",\"e\":{},\"l\":[]}";
+    for (int view = 0; view < 2; view++) {
+        JsonDoc* doc = view ? minijson_parse_view(src, strlen(src), NULL) : parse(src);
+        assert(doc != NULL);
+        int len;
+        char* out = minijson_to_str(&doc->root, &len);
+        assert(out != NULL && len == (int) strlen(want) && strcmp(out, want) == 0);
+        free(out);
+        minijson_free(doc);
+    }
+
+    // a fixed buffer that is too small fails instead of cutting the output
+    char small[8];
+    JsonWriter w;
+    jwriter_init(&w, small, sizeof(small));
+    jwriter_begin_array(&w);
+    jwriter_str(&w, "too long", 8);
+    jwriter_end_array(&w);
+    assert(jwriter_flush(&w) != 0);
+
+    // the event functions place the separators, a file descriptor writer flushes in chunks
+    int fds[2];
+    assert(pipe(fds) == 0);
+    jwriter_init_fd(&w, fds[1], 16);
+    jwriter_begin_object(&w);
+    jwriter_key(&w, "turn", 4);
+    jwriter_str(&w, "white", 5);
+    jwriter_key(&w, "moves", 5);
+    jwriter_begin_array(&w);
+    jwriter_int(&w, 12);
+    jwriter_double(&w, 0.5);
+    jwriter_begin_object(&w);
+    jwriter_end_object(&w);
+    jwriter_bool(&w, false);
+    jwriter_end_array(&w);
+    jwriter_key(&w, "x", 1);
+    jwriter_null(&w);
+    jwriter_end_object(&w);
+    assert(jwriter_flush(&w) == 0);
+    jwriter_free(&w);
+    close(fds[1]);
+    char got[128];
+    int n = read(fds[0], got, sizeof(got) - 1);
+    close(fds[0]);
+    assert(n > 0);
+    got[n] = '\0';
+    assert(strcmp(got, "{\"turn\":\"white\",\"moves\":[12,0.5,{},false],\"x\":null}") == 0);
+}
+
+typedef struct {
+    int objects, arrays, keys, values, docs;
+    int64_t sum;
+    char last[32];
+} SaxCount;
+
+static int sax_object(void* ctx) {
+    ((SaxCount*) ctx)->objects++;
+    return 0;
+}
+
+static int sax_array(void* ctx) {
+    ((SaxCount*) ctx)->arrays++;
+    return 0;
+}
+
+static int sax_key(void* ctx, const char* data, int len) {
+    ((SaxCount*) ctx)->keys++;
+    return 0;
+}
+
+static int sax_value(void* ctx, const JsonBaseObj* value) {
+    SaxCount* c = ctx;
+    c->values++;
+    if (value->type == JNum) c->sum += value->jsonNum.Int64;
+    if (value->type == JStr) snprintf(c->last, sizeof(c->last), "%.*s", value->jsonStr.len, value->jsonStr.data);
+    return 0;
+}
+
+static int sax_doc(void* ctx) {
+    ((SaxCount*) ctx)->docs++;
+    return 0;
+}
+
+static void test_sax() {
+    const char* lines =
+        "{\"ply\": 1, \"move\": \"e2e4\"}\n"
+        "{\"ply\": 22, \"move\": \"e\\u0037e5\", \"tags\": []}\n"
+        "300\n";
+    int len = strlen(lines);
+    // every chunk size gives the same events, tokens are cut anywhere
+    for (int chunk = 1; chunk <= len; chunk++) {
+        SaxCount c = { 0 };
+        JsonSaxHandler h = { &c, sax_object, NULL, sax_array, NULL, sax_key, sax_value, sax_doc };
+        JsonSax* sax = minijson_sax_new(&h);
+        for (int i = 0; i < len; i += chunk) {
+            assert(minijson_sax_feed(sax, lines + i, len - i < chunk ? len - i : chunk) == 0);
+        }
+        assert(minijson_sax_finish(sax) == 0);
+        assert(c.objects == 2 && c.arrays == 1 && c.keys == 5 && c.values == 5 && c.docs == 3);
+        assert(c.sum == 323 && strcmp(c.last, "e7e5") == 0);
+        minijson_sax_free(sax);
+    }
+
+    // the error offset counts from the start of the stream
+    JsonSaxHandler h = { NULL };
+    JsonSax* sax = minijson_sax_new(&h);
+    assert(minijson_sax_feed(sax, "[1, 2", 5) == 0);
+    assert(minijson_sax_feed(sax, ", x]", 4) != 0 && minijson_sax_errpos(sax) == 7);
+    minijson_sax_free(sax);
+
+    sax = minijson_sax_new(&h);
+    assert(minijson_sax_feed(sax, "{\"a\": [", 7) == 0 && minijson_sax_finish(sax) != 0);
+    minijson_sax_free(sax);
+}
+
+// strings and escapes across the 64 byte blocks of the structural scan give the same result on every scan
+static void test_scans() {
+    char src[4096];
+    char pad[41];
+    memset(pad, ' ', 40);
+    pad[40] = '\0';
+    int n = 0;
+    n += sprintf(src + n, "[");
+    for (int i = 0; i < 40; i++) {
+        n += sprintf(src + n, "%s\"%.*s\\\\\\\"x\", %d, true", i ? ", " : "", i, pad, i);
+    }
+    sprintf(src + n, "]");
+
+    JsonScanKind kinds[] = { JsonScanScalar, JsonScanSse2, JsonScanAvx2 };
+    for (int k = 0; k < 3; k++) {
+        minijson_set_scan(kinds[k]);
+        JsonDoc* doc = parse(src);
+        assert(doc != NULL && doc->root.jsonArray.length == 120);
+        for (int i = 0; i < 40; i++) {
+            const JsonStr* str = &doc->root.jsonArray.list[3 * i].jsonStr;
+            assert(str->len == i + 3 && memcmp(str->data + i, "\\\"x", 3) == 0);
+            assert(doc->root.jsonArray.list[3 * i + 1].jsonNum.Int64 == i);
+        }
+        minijson_free(doc);
+
+        int pos = -1;
+        assert(minijson_parse_str("[\"ab\x01\"]", 7, &pos) == NULL && pos == 1);
+    }
+    minijson_set_scan(JsonScanAuto);
+}
+
+int main() {
+    printf("%s\n", minijson_version());
+    test_values();
+    test_strings();
+    test_errors();
+    test_scans();
+    test_views();
+    test_sax();
+    test_map_get();
+    test_write();
     return 0;
 }
@@ -0,0 +1,393 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "chess.h"
+#include "search.h"
+#include "tablebase.h"
+
+#define MAXWORKERS 256
+#define FENLEN 100
+
+typedef struct {
+    uint64_t seq;
+    char fen[FENLEN];
+} Task;
+
+typedef struct {
+    bool ready;
+    Task task;
+    SearchResult res;
+} Slot;
+
+typedef struct {
+    SearchConfig cfg;
+    FILE* in;
+    int workerNum;
+    uint64_t skip;  // positions already written by the resumed run
+
+    // reader -> workers, a bounded queue
+    pthread_mutex_t lock;
+    pthread_cond_t notFull;
+    pthread_cond_t notEmpty;
+    Task* queue;
+    int queueCap;
+    int queueHead;
+    int queueLen;
+    bool inputDone;
+
+    // workers -> writer, results are reordered in a window of the sequence numbers
+    pthread_cond_t slotReady;
+    pthread_cond_t windowFree;
+    Slot* window;
+    int windowCap;
+    uint64_t written;
+    uint64_t total;  // known once the input is done
+} Pipeline;
+
+// a line is a FEN, a header of a PGN or moves of a game, which may span lines and ends at a result
+typedef struct {
+    GameState* game;
+    bool inGame;
+    uint64_t seq;
+} Reader;
+
+static bool wait_window(Pipeline* p, uint64_t seq) {
+    pthread_mutex_lock(&p->lock);
+    // the reader never gets ahead of the writer by more than the window
+    while (seq >= p->written + p->windowCap) {
+        pthread_cond_wait(&p->windowFree, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return true;
+}
+
+static void push_task(Pipeline* p, Reader* r, const GameState* game) {
+    uint64_t seq = r->seq++;
+    if (seq < p->skip) return;
+    wait_window(p, seq);
+
+    pthread_mutex_lock(&p->lock);
+    while (p->queueLen == p->queueCap) {
+        pthread_cond_wait(&p->notFull, &p->lock);
+    }
+    Task* t = &p->queue[(p->queueHead + p->queueLen) % p->queueCap];
+    t->seq = seq;
+    Game_toFen(game, t->fen, FENLEN);
+    p->queueLen++;
+    pthread_cond_signal(&p->notEmpty);
+    pthread_mutex_unlock(&p->lock);
+}
+
+static bool is_result(const char* tok) {
+    return strcmp(tok, "1-0") == 0 || strcmp(tok, "0-1") == 0 || strcmp(tok, "1/2-1/2") == 0 || strcmp(tok, "*") == 0;
+}
+
+// the board field of a FEN has 7 slashes, a result like 1/2-1/2 has fewer
+static bool is_fen(const char* line) {
+    int slashes = 0;
+    for (const char* c = line; *c != '\0' && *c != ' ' && *c != '\t'; c++) slashes += *c == '/';
+    return slashes == 7;
+}
+
+static void read_line(Pipeline* p, Reader* r, char* line, uint64_t lineNo) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[0] == '[') return;
+    if (line[0] == '\0') {
+        r->inGame = false;
+        return;
+    }
+
+    char* first = line + strspn(line, " \t");
+    if (is_fen(first)) {
+        if (Game_fromFen(r->game, first) != 0) {
+            fprintf(stderr, "line %llu: bad fen\n", (unsigned long long) lineNo);
+            return;
+        }
+        r->inGame = false;
+        push_task(p, r, r->game);
+        return;
+    }
+
+    char* save;
+    for (char* tok = strtok_r(line, " \t", &save); tok != NULL; tok = strtok_r(NULL, " \t", &save)) {
+        if (!r->inGame) {
+            InitGame(r->game);
+            r->inGame = true;
+            push_task(p, r, r->game);
+        }
+        if (is_result(tok)) {
+            r->inGame = false;
+            continue;
+        }
+        char* dot = strrchr(tok, '.');
+        if (dot != NULL) tok = dot + 1;
+        if (tok[0] == '\0') continue;
+
+        Response resp = r->game->isFinished ? ErrAlreadyFinish : Game_exec(r->game, tok);
+        if (resp != Success) {
+            fprintf(stderr, "line %llu: %s %s\n", (unsigned long long) lineNo, tok, Response_tostr(resp));
+            // skip the rest of this game, the positions seen so far stay counted
+            r->game->isFinished = true;
+            continue;
+        }
+        push_task(p, r, r->game);
+    }
+}
+
+static void* reader_main(void* arg) {
+    Pipeline* p = arg;
+    Reader r = { .game = malloc(sizeof(GameState)) };
+    // a game may be written on one long line, it is read whole
+    char* line = NULL;
+    size_t cap = 0;
+    uint64_t lineNo = 0;
+    while (getline(&line, &cap, p->in) != -1) {
+        read_line(p, &r, line, ++lineNo);
+    }
+    free(line);
+    free(r.game);
+
+    pthread_mutex_lock(&p->lock);
+    p->inputDone = true;
+    p->total = r.seq;
+    pthread_cond_broadcast(&p->notEmpty);
+    pthread_cond_broadcast(&p->slotReady);
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static void* worker_main(void* arg) {
+    Pipeline* p = arg;
+    GameState* game = malloc(sizeof(GameState));
+    while (1) {
+        pthread_mutex_lock(&p->lock);
+        while (p->queueLen == 0 && !p->inputDone) {
+            pthread_cond_wait(&p->notEmpty, &p->lock);
+        }
+        if (p->queueLen == 0) {
+            pthread_mutex_unlock(&p->lock);
+            break;
+        }
+        Task task = p->queue[p->queueHead];
+        p->queueHead = (p->queueHead + 1) % p->queueCap;
+        p->queueLen--;
+        pthread_cond_signal(&p->notFull);
+        pthread_mutex_unlock(&p->lock);
+
+        SearchResult res;
+        Game_fromFen(game, task.fen);
+        Search_run(game, &p->cfg, &res);
+
+        pthread_mutex_lock(&p->lock);
+        Slot* slot = &p->window[task.seq % p->windowCap];
+        slot->task = task;
+        slot->res = res;
+        slot->ready = true;
+        pthread_cond_broadcast(&p->slotReady);
+        pthread_mutex_unlock(&p->lock);
+    }
+    free(game);
+    return NULL;
+}
+
+static void format_score(int score, char* buf, int len) {
+    if (score > SEARCH_MATE - 1000) {
+        snprintf(buf, len, "M%d", (SEARCH_MATE - score + 1) / 2);
+    } else if (score < -SEARCH_MATE + 1000) {
+        snprintf(buf, len, "-M%d", (SEARCH_MATE + score) / 2);
+    } else {
+        snprintf(buf, len, "%d", score);
+    }
+}
+
+// the output is made durable first, then the checkpoint is replaced atomically
+static int write_checkpoint(const char* outPath, FILE* out, uint64_t written) {
+    if (fflush(out) != 0 || fsync(fileno(out)) != 0) return -1;
+    char path[4096], tmp[4096];
+    snprintf(path, sizeof(path), "%s.ckpt", outPath);
+    snprintf(tmp, sizeof(tmp), "%s.ckpt.tmp", outPath);
+
+    FILE* f = fopen(tmp, "w");
+    if (f == NULL) return -1;
+    fprintf(f, "%llu %ld\n", (unsigned long long) written, ftell(out));
+    if (fflush(f) != 0 || fsync(fileno(f)) != 0) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    return rename(tmp, path);
+}
+
+static int read_checkpoint(const char* outPath, uint64_t* written, long* bytes) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s.ckpt", outPath);
+    FILE* f = fopen(path, "r");
+    if (f == NULL) return errno == ENOENT ? 1 : -1;
+    unsigned long long n;
+    int ok = fscanf(f, "%llu %ld", &n, bytes) == 2;
+    fclose(f);
+    *written = n;
+    return ok ? 0 : -1;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "usage: %s [-d depth] [-n nodes] [-j threads] [-c checkpoint] [-r] [-t table.mctb]...\n", name);
+    fprintf(stderr, "          -o out.tsv input\n");
+    fprintf(stderr, "input lines are FENs or games in coordinate moves, PGN headers and move numbers are skipped\n");
+}
+
+int main(int argc, char** argv) {
+    static Pipeline p;
+    static Tablebase tables[TB_MAXTABLES];
+    int tableNum = 0;
+    p.cfg.depth = 3;
+    p.workerNum = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t checkpointEvery = 1000;
+    bool resume = false;
+    const char* outPath = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:n:j:c:ro:t:")) != -1) {
+        switch (opt) {
+        case 'd':
+            p.cfg.depth = atoi(optarg);
+            break;
+        case 'n':
+            p.cfg.maxNodes = strtoull(optarg, NULL, 10);
+            if (p.cfg.maxNodes != 0) p.cfg.depth = SEARCH_MAXDEPTH;
+            break;
+        case 'j':
+            p.workerNum = atoi(optarg);
+            break;
+        case 'c':
+            checkpointEvery = strtoull(optarg, NULL, 10);
+            break;
+        case 'r':
+            resume = true;
+            break;
+        case 'o':
+            outPath = optarg;
+            break;
+        case 't':
+            if (tableNum == TB_MAXTABLES || Tablebase_load(&tables[tableNum], optarg) != 0 ||
+                Tablebase_register(&tables[tableNum]) != 0) {
+                fprintf(stderr, "load tablebase %s failed\n", optarg);
+                return 1;
+            }
+            tableNum++;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (outPath == NULL || optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (p.workerNum < 1) p.workerNum = 1;
+    if (p.workerNum > MAXWORKERS) p.workerNum = MAXWORKERS;
+    if (checkpointEvery == 0) checkpointEvery = 1;
+
+    p.in = fopen(argv[optind], "r");
+    if (p.in == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    // a resumed run drops whatever was written after the last checkpoint
+    FILE* out;
+    if (resume) {
+        long bytes = 0;
+        int ret = read_checkpoint(outPath, &p.skip, &bytes);
+        if (ret < 0 || (ret == 0 && truncate(outPath, bytes) != 0)) {
+            fprintf(stderr, "%s: bad checkpoint\n", outPath);
+            return 1;
+        }
+        out = fopen(outPath, ret == 0 ? "a" : "w");
+    } else {
+        out = fopen(outPath, "w");
+    }
+    if (out == NULL) {
+        perror(outPath);
+        return 1;
+    }
+
+    pthread_mutex_init(&p.lock, NULL);
+    pthread_cond_init(&p.notFull, NULL);
+    pthread_cond_init(&p.notEmpty, NULL);
+    pthread_cond_init(&p.slotReady, NULL);
+    pthread_cond_init(&p.windowFree, NULL);
+    p.queueCap = p.workerNum * 4;
+    p.queue = malloc(sizeof(Task) * p.queueCap);
+    p.windowCap = p.workerNum * 16;
+    p.window = calloc(p.windowCap, sizeof(Slot));
+    p.written = p.skip;
+    p.total = UINT64_MAX;
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    pthread_t reader;
+    pthread_t workers[MAXWORKERS];
+    pthread_create(&reader, NULL, reader_main, &p);
+    for (int i = 0; i < p.workerNum; i++) {
+        pthread_create(&workers[i], NULL, worker_main, &p);
+    }
+
+    // the main thread is the ordered writer
+    uint64_t nodes = 0;
+    pthread_mutex_lock(&p.lock);
+    while (p.written < p.total) {
+        Slot* slot = &p.window[p.written % p.windowCap];
+        if (!slot->ready) {
+            pthread_cond_wait(&p.slotReady, &p.lock);
+            continue;
+        }
+        Slot done = *slot;
+        slot->ready = false;
+        pthread_mutex_unlock(&p.lock);
+
+        char score[16], best[5] = "-";
+        format_score(done.res.score, score, sizeof(score));
+        if (done.res.hasMove) Step_tostr(&done.res.best, best);
+        fprintf(out, "%llu\t%s\t%s\t%s\t%d\t%llu\n", (unsigned long long) done.task.seq, done.task.fen, score, best,
+                done.res.depth, (unsigned long long) done.res.nodes);
+        nodes += done.res.nodes;
+
+        pthread_mutex_lock(&p.lock);
+        p.written++;
+        pthread_cond_broadcast(&p.windowFree);
+        if (p.written % checkpointEvery == 0) {
+            pthread_mutex_unlock(&p.lock);
+            if (write_checkpoint(outPath, out, p.written) != 0) perror("checkpoint");
+            pthread_mutex_lock(&p.lock);
+        }
+    }
+    pthread_mutex_unlock(&p.lock);
+
+    pthread_join(reader, NULL);
+    for (int i = 0; i < p.workerNum; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    if (write_checkpoint(outPath, out, p.written) != 0) perror("checkpoint");
+    fclose(out);
+    fclose(p.in);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double secs = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+    uint64_t analyzed = p.written - p.skip;
+    fprintf(stderr, "%llu positions in %.2fs, %.1f positions/s, %.0f nodes/s\n", (unsigned long long) analyzed, secs,
+            analyzed / secs, nodes / secs);
+
+    free(p.queue);
+    free(p.window);
+    for (int i = 0; i < tableNum; i++) {
+        Tablebase_free(&tables[i]);
+    }
+    return 0;
+}
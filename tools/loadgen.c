@@ -0,0 +1,414 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "chess.h"
+#include "minijson.h"
+
+#define MAXWORKERS 256
+#define MAXEVENTS 256
+#define CLIENT_INBUF 65536
+
+typedef struct LoadGame LoadGame;
+
+typedef struct {
+    int fd;
+    LoadGame* game;
+    Team seat;     // NoTeam for a spectator
+    bool pending;  // a move of this client waits for its update
+    uint64_t sentNs;
+    char in[CLIENT_INBUF];
+    int inLen;
+} Client;
+
+// the moves are picked from a local copy of the game, the server has the real one
+struct LoadGame {
+    int id;
+    int round;
+    char name[32];
+    Client* players[2];
+    Client* watchers;
+    GameState state;
+};
+
+typedef struct {
+    const char* addr;
+    int port;
+    int games;
+    int watchers;  // spectators per game
+    int workerNum;
+    int maxPlies;
+    double seconds;
+    bool json;
+    pthread_barrier_t start;
+} Loadgen;
+
+typedef struct {
+    Loadgen* lg;
+    int id;
+    uint32_t* lat;  // nanoseconds from sending a move to its update
+    size_t latLen;
+    size_t latCap;
+    uint64_t moves;
+    uint64_t updates;
+    uint64_t rounds;
+    uint64_t errors;
+} Worker;
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int connect_to(const char* addr, int port) {
+    struct sockaddr_in sa = { .sin_family = AF_INET, .sin_port = htons(port) };
+    if (inet_pton(AF_INET, addr, &sa.sin_addr) != 1) return -1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*) &sa, sizeof(sa)) != 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// the commands are short, a full socket only happens when the server falls far behind
+static void send_all(Client* c, const char* data, int len) {
+    while (len > 0) {
+        ssize_t n = send(c->fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN) {
+                struct pollfd p = { .fd = c->fd, .events = POLLOUT };
+                poll(&p, 1, 100);
+            } else if (errno != EINTR) {
+                return;
+            }
+            continue;
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+static void send_join(Worker* w, Client* c) {
+    const char* seat = c->seat == White ? "white" : c->seat == Black ? "black" : "watch";
+    char buf[128];
+    int len = w->lg->json ? snprintf(buf, sizeof(buf), "{\"cmd\":\"join\",\"game\":\"%s\",\"as\":\"%s\"}\n",
+                                     c->game->name, seat)
+                          : snprintf(buf, sizeof(buf), "join %s %s\n", c->game->name, seat);
+    c->pending = false;
+    send_all(c, buf, len);
+}
+
+// a move spread over the legal ones, the same game every run
+static void send_move(Worker* w, LoadGame* g) {
+    Step moves[256];
+    int n = Game_legalMoves(&g->state, moves, 256);
+    if (n == 0) return;
+    char move[5], buf[64];
+    Step_tostr(&moves[(g->state.stepNum * 7919 + g->id) % n], move);
+    int len = w->lg->json ? snprintf(buf, sizeof(buf), "{\"cmd\":\"move\",\"move\":\"%s\"}\n", move)
+                          : snprintf(buf, sizeof(buf), "move %s\n", move);
+    Client* c = g->players[g->state.turn];
+    c->pending = true;
+    c->sentNs = now_ns();
+    send_all(c, buf, len);
+}
+
+// a new game name each round, joining it leaves the old game on the server
+static void start_round(Worker* w, LoadGame* g) {
+    g->round++;
+    snprintf(g->name, sizeof(g->name), "lg%d.%d", g->id, g->round);
+    InitGame(&g->state);
+    send_join(w, g->players[White]);
+    send_join(w, g->players[Black]);
+    for (int i = 0; i < w->lg->watchers; i++) {
+        send_join(w, &g->watchers[i]);
+    }
+    send_move(w, g);
+}
+
+static void on_update(Worker* w, Client* c, const char* name, int nameLen, int ply, const char* move) {
+    LoadGame* g = c->game;
+    w->updates++;
+    // every client of the game gets it, only the mover acts on it
+    if (!c->pending || nameLen != (int) strlen(g->name) || memcmp(name, g->name, nameLen) != 0) return;
+    if (ply != g->state.stepNum + 1) return;
+
+    uint64_t ns = now_ns() - c->sentNs;
+    if (w->latLen == w->latCap) {
+        w->latCap = w->latCap * 2 + 4096;
+        w->lat = realloc(w->lat, sizeof(uint32_t) * w->latCap);
+    }
+    w->lat[w->latLen++] = ns > UINT32_MAX ? UINT32_MAX : ns;
+    w->moves++;
+    c->pending = false;
+
+    char cmd[5];
+    memcpy(cmd, move, 4);
+    cmd[4] = '\0';
+    if (Game_exec(&g->state, cmd) != Success) {
+        w->errors++;
+        start_round(w, g);
+    } else if (g->state.isFinished || g->state.stepNum >= w->lg->maxPlies) {
+        w->rounds++;
+        start_round(w, g);
+    } else {
+        send_move(w, g);
+    }
+}
+
+// "update <game> <ply> <move> <fen>", "err <reason>"
+static void on_text(Worker* w, Client* c, char* line) {
+    char name[32], move[5];
+    int ply;
+    if (strncmp(line, "update ", 7) == 0 && sscanf(line + 7, "%31s %d %4s", name, &ply, move) == 3) {
+        on_update(w, c, name, strlen(name), ply, move);
+    } else if (strncmp(line, "err ", 4) == 0 && c->seat != NoTeam) {
+        w->errors++;
+        start_round(w, c->game);
+    }
+}
+
+// {"game":"lg1.1","delta":{"since":0,"ply":1,...,"moves":["Pe2e4"]}}, {"ok":false,"error":"..."}
+static void on_json(Worker* w, Client* c, const char* line, int len) {
+    JsonDoc* doc = minijson_parse_view(line, len, NULL);
+    if (doc == NULL || doc->root.type != JMap) {
+        w->errors++;
+    } else {
+        const JsonMap* m = &doc->root.jsonMap;
+        const JsonBaseObj* game = minijson_map_get(m, "game", 4);
+        const JsonBaseObj* delta = minijson_map_get(m, "delta", 5);
+        const JsonBaseObj* ok = minijson_map_get(m, "ok", 2);
+        if (game != NULL && game->type == JStr && delta != NULL && delta->type == JMap) {
+            const JsonBaseObj* ply = minijson_map_get(&delta->jsonMap, "ply", 3);
+            const JsonBaseObj* moves = minijson_map_get(&delta->jsonMap, "moves", 5);
+            const JsonBaseObj* move = moves != NULL && moves->type == JArray && moves->jsonArray.length == 1
+                                          ? &moves->jsonArray.list[0]
+                                          : NULL;
+            // the squares follow the piece letter
+            if (ply != NULL && ply->type == JNum && move != NULL && move->type == JStr && move->jsonStr.len >= 5) {
+                on_update(w, c, game->jsonStr.data, game->jsonStr.len, ply->jsonNum.Int64, move->jsonStr.data + 1);
+            }
+        } else if (ok != NULL && ok->type == JBool && !ok->jsonBool.data && c->seat != NoTeam) {
+            w->errors++;
+            start_round(w, c->game);
+        }
+    }
+    minijson_free(doc);
+}
+
+static int client_read(Worker* w, Client* c) {
+    ssize_t n = read(c->fd, c->in + c->inLen, CLIENT_INBUF - c->inLen);
+    if (n <= 0) return n < 0 && (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+    c->inLen += n;
+
+    char* start = c->in;
+    char* end = c->in + c->inLen;
+    char* nl;
+    while ((nl = memchr(start, '\n', end - start)) != NULL) {
+        *nl = '\0';
+        if (*start == '{') {
+            on_json(w, c, start, nl - start);
+        } else {
+            on_text(w, c, start);
+        }
+        start = nl + 1;
+    }
+    c->inLen = end - start;
+    if (c->inLen == CLIENT_INBUF) return -1;
+    memmove(c->in, start, c->inLen);
+    return 0;
+}
+
+static int add_client(Worker* w, int epfd, LoadGame* g, Client* c, Team seat) {
+    c->fd = connect_to(w->lg->addr, w->lg->port);
+    c->game = g;
+    c->seat = seat;
+    if (c->fd < 0) return -1;
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+}
+
+static void* worker_main(void* arg) {
+    Worker* w = arg;
+    Loadgen* lg = w->lg;
+    int epfd = epoll_create1(0);
+
+    // the games of this worker are every workerNum-th one
+    int gameNum = (lg->games - w->id + lg->workerNum - 1) / lg->workerNum;
+    LoadGame* games = calloc(gameNum, sizeof(LoadGame));
+    bool failed = false;
+    int made = 0;
+    for (; made < gameNum && !failed; made++) {
+        LoadGame* g = &games[made];
+        g->id = w->id + made * lg->workerNum;
+        g->players[White] = calloc(1, sizeof(Client));
+        g->players[Black] = calloc(1, sizeof(Client));
+        g->watchers = calloc(lg->watchers, sizeof(Client));
+        failed = add_client(w, epfd, g, g->players[White], White) != 0 ||
+                 add_client(w, epfd, g, g->players[Black], Black) != 0;
+        for (int k = 0; k < lg->watchers && !failed; k++) {
+            failed = add_client(w, epfd, g, &g->watchers[k], NoTeam) != 0;
+        }
+    }
+    if (failed) {
+        fprintf(stderr, "connect to %s:%d failed: %s\n", lg->addr, lg->port, strerror(errno));
+        w->errors++;
+        gameNum = 0;
+    }
+
+    // every worker has its connections before the clock starts
+    pthread_barrier_wait(&lg->start);
+    uint64_t deadline = now_ns() + (uint64_t) (lg->seconds * 1e9);
+    for (int i = 0; i < gameNum; i++) {
+        start_round(w, &games[i]);
+    }
+    struct epoll_event events[MAXEVENTS];
+    while (gameNum > 0 && now_ns() < deadline) {
+        int n = epoll_wait(epfd, events, MAXEVENTS, 100);
+        for (int i = 0; i < n; i++) {
+            Client* c = events[i].data.ptr;
+            if (client_read(w, c) != 0) {
+                fprintf(stderr, "connection of %s closed\n", c->game->name);
+                epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+                w->errors++;
+            }
+        }
+    }
+
+    for (int i = 0; i < made; i++) {
+        LoadGame* g = &games[i];
+        for (int k = 0; k < 2 + lg->watchers; k++) {
+            Client* c = k < 2 ? g->players[k] : &g->watchers[k - 2];
+            if (c->fd > 0) close(c->fd);
+        }
+        free(g->players[White]);
+        free(g->players[Black]);
+        free(g->watchers);
+    }
+    free(games);
+    close(epfd);
+    return NULL;
+}
+
+static int cmp_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*) a, y = *(const uint32_t*) b;
+    return x < y ? -1 : x > y;
+}
+
+static void summary(const Loadgen* lg, Worker* workers) {
+    uint64_t moves = 0, updates = 0, rounds = 0, errors = 0;
+    size_t latLen = 0;
+    for (int i = 0; i < lg->workerNum; i++) {
+        moves += workers[i].moves;
+        updates += workers[i].updates;
+        rounds += workers[i].rounds;
+        errors += workers[i].errors;
+        latLen += workers[i].latLen;
+    }
+    uint32_t* lat = malloc(sizeof(uint32_t) * (latLen + 1));
+    size_t n = 0;
+    for (int i = 0; i < lg->workerNum; i++) {
+        memcpy(lat + n, workers[i].lat, sizeof(uint32_t) * workers[i].latLen);
+        n += workers[i].latLen;
+    }
+    qsort(lat, latLen, sizeof(uint32_t), cmp_u32);
+
+    printf("%llu moves in %.2fs, %.0f moves/s, %llu updates, %llu finished games, %llu errors\n",
+           (unsigned long long) moves, lg->seconds, moves / lg->seconds, (unsigned long long) updates,
+           (unsigned long long) rounds, (unsigned long long) errors);
+    if (latLen > 0) {
+        static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+        printf("latency us:");
+        for (int i = 0; i < 4; i++) {
+            printf(" p%g %.1f", quantiles[i] * 100, lat[(size_t) (quantiles[i] * (latLen - 1))] / 1e3);
+        }
+        printf(" max %.1f\n", lat[latLen - 1] / 1e3);
+    }
+    free(lat);
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "usage: %s [-a addr] [-p port] [-g games] [-w watchers] [-j threads] [-d seconds]\n", name);
+    fprintf(stderr, "          [-m maxplies] [-J]\n");
+}
+
+int main(int argc, char** argv) {
+    static Loadgen lg = { .addr = "127.0.0.1", .port = 7000, .games = 64, .maxPlies = 200, .seconds = 5 };
+    lg.workerNum = sysconf(_SC_NPROCESSORS_ONLN);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "a:p:g:w:j:d:m:J")) != -1) {
+        switch (opt) {
+        case 'a':
+            lg.addr = optarg;
+            break;
+        case 'p':
+            lg.port = atoi(optarg);
+            break;
+        case 'g':
+            lg.games = atoi(optarg);
+            break;
+        case 'w':
+            lg.watchers = atoi(optarg);
+            break;
+        case 'j':
+            lg.workerNum = atoi(optarg);
+            break;
+        case 'd':
+            lg.seconds = atof(optarg);
+            break;
+        case 'm':
+            lg.maxPlies = atoi(optarg);
+            break;
+        case 'J':
+            lg.json = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (lg.games < 1 || lg.watchers < 0 || lg.seconds <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (lg.workerNum < 1) lg.workerNum = 1;
+    if (lg.workerNum > MAXWORKERS) lg.workerNum = MAXWORKERS;
+    if (lg.workerNum > lg.games) lg.workerNum = lg.games;
+    if (lg.maxPlies > MAXSTEPS) lg.maxPlies = MAXSTEPS;
+
+    pthread_barrier_init(&lg.start, NULL, lg.workerNum);
+    static Worker workers[MAXWORKERS];
+    pthread_t tids[MAXWORKERS];
+    for (int i = 0; i < lg.workerNum; i++) {
+        workers[i].lg = &lg;
+        workers[i].id = i;
+        pthread_create(&tids[i], NULL, worker_main, &workers[i]);
+    }
+    for (int i = 0; i < lg.workerNum; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    summary(&lg, workers);
+    for (int i = 0; i < lg.workerNum; i++) {
+        free(workers[i].lat);
+    }
+    pthread_barrier_destroy(&lg.start);
+    return 0;
+}
@@ -0,0 +1,306 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "chess.h"
+#include "search.h"
+#include "tablebase.h"
+
+#define MAXWORKERS 256
+
+// the games of a worker, the owner pops from the tail and thieves take from the head
+typedef struct {
+    pthread_mutex_t lock;
+    int* tasks;
+    int head;
+    int tail;
+} Deque;
+
+typedef struct {
+    SearchConfig engines[2];  // engine A and engine B
+    int games;
+    int maxPlies;
+    uint64_t seed;
+    int workerNum;
+    Deque deques[MAXWORKERS];
+
+    pthread_mutex_t outLock;
+    FILE* out;
+    int done;
+    int results[3];  // wins, draws and losses of engine A
+    int unfinished;  // cut off at maxPlies or without a move, not scored
+    uint64_t plies;
+    uint64_t nodes;
+    uint64_t steals;
+} Tournament;
+
+typedef struct {
+    Tournament* t;
+    int id;
+} Worker;
+
+static int parse_engine(SearchConfig* cfg, const char* str) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", str);
+    for (char* tok = strtok(buf, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        char* eq = strchr(tok, '=');
+        if (eq == NULL) return -1;
+        *eq = '\0';
+        long v = atol(eq + 1);
+        if (strcmp(tok, "depth") == 0) {
+            cfg->depth = v;
+        } else if (strcmp(tok, "nodes") == 0) {
+            cfg->maxNodes = v;
+        } else if (strcmp(tok, "noise") == 0) {
+            cfg->noise = v;
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static bool deque_pop(Deque* d, int* task) {
+    bool ok = false;
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head) {
+        *task = d->tasks[--d->tail];
+        ok = true;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+static bool deque_steal(Deque* d, int* task) {
+    bool ok = false;
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head) {
+        *task = d->tasks[d->head++];
+        ok = true;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+static bool next_task(Tournament* t, int self, int* task) {
+    if (deque_pop(&t->deques[self], task)) return true;
+    // no game is ever added, so when every deque is empty the work is done
+    for (int i = 1; i < t->workerNum; i++) {
+        if (deque_steal(&t->deques[(self + i) % t->workerNum], task)) {
+            __atomic_fetch_add(&t->steals, 1, __ATOMIC_RELAXED);
+            return true;
+        }
+    }
+    return false;
+}
+
+static const char* result_str(const GameState* game) {
+    if (!game->isFinished) return "*";
+    if (game->winner == NoTeam) return "1/2-1/2";
+    return game->winner == White ? "1-0" : "0-1";
+}
+
+static void write_game(Tournament* t, int round, int whiteEngine, const GameState* game) {
+    fprintf(t->out, "[Event \"minichess selfplay\"]\n");
+    fprintf(t->out, "[Round \"%d\"]\n", round + 1);
+    fprintf(t->out, "[White \"%c\"]\n", 'A' + whiteEngine);
+    fprintf(t->out, "[Black \"%c\"]\n", 'B' - whiteEngine);
+    fprintf(t->out, "[Result \"%s\"]\n", result_str(game));
+    fprintf(t->out, "[PlyCount \"%d\"]\n\n", game->stepNum);
+
+    int col = 0;
+    for (int i = 0; i < game->stepNum && i < MAXSTEPS; i++) {
+        char move[5];
+        Step_tostr(&game->history[i], move);
+        col += i % 2 == 0 ? fprintf(t->out, "%d. %s ", i / 2 + 1, move) : fprintf(t->out, "%s ", move);
+        if (col > 72) {
+            fprintf(t->out, "\n");
+            col = 0;
+        }
+    }
+    fprintf(t->out, "%s\n\n", result_str(game));
+}
+
+static void play_game(Tournament* t, int round, GameState* game) {
+    // engine A plays white in the even rounds
+    int whiteEngine = round % 2;
+    InitGame(game);
+    uint64_t nodes = 0;
+
+    while (!game->isFinished && game->stepNum < t->maxPlies) {
+        SearchConfig cfg = t->engines[game->turn == White ? whiteEngine : 1 - whiteEngine];
+        cfg.seed = t->seed ^ ((uint64_t) round << 32) ^ (game->stepNum + 1);
+        SearchResult res;
+        Search_run(game, &cfg, &res);
+        nodes += res.nodes;
+        if (!res.hasMove || Game_execStep(game, &res.best) != Success) break;
+    }
+
+    int result = 1;
+    if (game->isFinished && game->winner != NoTeam) {
+        bool whiteWins = game->winner == White;
+        result = whiteWins == (whiteEngine == 0) ? 0 : 2;
+    }
+
+    pthread_mutex_lock(&t->outLock);
+    if (game->isFinished) {
+        t->results[result]++;
+    } else {
+        t->unfinished++;
+    }
+    t->done++;
+    t->plies += game->stepNum;
+    t->nodes += nodes;
+    if (t->out != NULL) {
+        write_game(t, round, whiteEngine, game);
+        fflush(t->out);
+    }
+    pthread_mutex_unlock(&t->outLock);
+}
+
+static void* worker_main(void* arg) {
+    Worker* w = arg;
+    GameState* game = malloc(sizeof(GameState));
+    int task;
+    while (next_task(w->t, w->id, &task)) {
+        play_game(w->t, task, game);
+    }
+    free(game);
+    return NULL;
+}
+
+static double elo_of(double score) {
+    if (score <= 0) return -INFINITY;
+    if (score >= 1) return INFINITY;
+    return -400 * log10(1 / score - 1);
+}
+
+static void summary(const Tournament* t, double secs) {
+    int w = t->results[0], d = t->results[1], l = t->results[2];
+    int n = w + d + l;
+    double score = n == 0 ? 0.5 : (w + 0.5 * d) / n;
+    double var = n == 0 ? 0
+                        : (w * pow(1 - score, 2) + d * pow(0.5 - score, 2) + l * pow(0 - score, 2)) / n;
+    double margin = 1.96 * sqrt(var / (n == 0 ? 1 : n));
+
+    printf("games %d: A +%d =%d -%d, score %.1f%%", t->done, w, d, l, score * 100);
+    if (t->unfinished > 0) printf(", %d unfinished games not scored", t->unfinished);
+    printf("\n");
+    if (score <= 0 || score >= 1) {
+        printf("elo A - B: %+f\n", elo_of(score));
+    } else {
+        double lo = elo_of(score - margin > 0 ? score - margin : 0);
+        double hi = elo_of(score + margin < 1 ? score + margin : 1);
+        printf("elo A - B: %+.1f [%+.1f, %+.1f] (95%%)\n", elo_of(score), lo, hi);
+    }
+    printf("time %.2fs, %.2f games/s, %.0f plies/s, %.0f nodes/s, %llu steals\n", secs, t->done / secs,
+           t->plies / secs, t->nodes / secs, (unsigned long long) t->steals);
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "usage: %s [-n games] [-j threads] [-a engine] [-b engine] [-p maxplies] [-s seed]\n", name);
+    fprintf(stderr, "          [-o games.pgn] [-t table.mctb]...\n");
+    fprintf(stderr, "engine: depth=2,nodes=0,noise=20\n");
+}
+
+int main(int argc, char** argv) {
+    static Tournament t;
+    static Tablebase tables[TB_MAXTABLES];
+    int tableNum = 0;
+    SearchConfig base = { .depth = 2, .noise = 20 };
+    t.engines[0] = base;
+    t.engines[1] = base;
+    t.games = 100;
+    t.maxPlies = 300;
+    t.seed = 1;
+    t.workerNum = sysconf(_SC_NPROCESSORS_ONLN);
+    const char* outPath = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:j:a:b:p:s:o:t:")) != -1) {
+        switch (opt) {
+        case 'n':
+            t.games = atoi(optarg);
+            break;
+        case 'j':
+            t.workerNum = atoi(optarg);
+            break;
+        case 'a':
+        case 'b':
+            if (parse_engine(&t.engines[opt - 'a'], optarg) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'p':
+            t.maxPlies = atoi(optarg);
+            break;
+        case 's':
+            t.seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'o':
+            outPath = optarg;
+            break;
+        case 't':
+            if (tableNum == TB_MAXTABLES || Tablebase_load(&tables[tableNum], optarg) != 0 ||
+                Tablebase_register(&tables[tableNum]) != 0) {
+                fprintf(stderr, "load tablebase %s failed\n", optarg);
+                return 1;
+            }
+            tableNum++;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (t.workerNum < 1) t.workerNum = 1;
+    if (t.workerNum > MAXWORKERS) t.workerNum = MAXWORKERS;
+    if (t.maxPlies > MAXSTEPS) t.maxPlies = MAXSTEPS;
+
+    if (outPath != NULL) {
+        t.out = fopen(outPath, "w");
+        if (t.out == NULL) {
+            perror(outPath);
+            return 1;
+        }
+    }
+
+    // deal the games round robin, idle workers steal the rest
+    for (int i = 0; i < t.workerNum; i++) {
+        pthread_mutex_init(&t.deques[i].lock, NULL);
+        t.deques[i].tasks = malloc(sizeof(int) * (t.games / t.workerNum + 1));
+    }
+    for (int i = 0; i < t.games; i++) {
+        Deque* d = &t.deques[i % t.workerNum];
+        d->tasks[d->tail++] = i;
+    }
+    pthread_mutex_init(&t.outLock, NULL);
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    pthread_t tids[MAXWORKERS];
+    Worker workers[MAXWORKERS];
+    for (int i = 0; i < t.workerNum; i++) {
+        workers[i].t = &t;
+        workers[i].id = i;
+        pthread_create(&tids[i], NULL, worker_main, &workers[i]);
+    }
+    for (int i = 0; i < t.workerNum; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    summary(&t, (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9);
+    if (t.out != NULL) fclose(t.out);
+    for (int i = 0; i < t.workerNum; i++) {
+        free(t.deques[i].tasks);
+    }
+    for (int i = 0; i < tableNum; i++) {
+        Tablebase_free(&tables[i]);
+    }
+    return 0;
+}
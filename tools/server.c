@@ -0,0 +1,694 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "chess.h"
+#include "minijson.h"
+#include "snapshot.h"
+#include "tablebase.h"
+
+#define MAXWORKERS 256
+#define MAXEVENTS 256
+#define GAME_BUCKETS 4096
+#define GAME_NAMELEN 32
+#define CONN_INBUF 4096
+// a client reading slower than this is cut off instead of growing its buffer forever
+#define CONN_OUTLIMIT (4 << 20)
+
+typedef struct Game Game;
+
+// a connection lives on the worker that accepted it, other workers only append to its output
+typedef struct {
+    int fd;
+    bool json;  // the framing of the last command, updates are pushed in it too
+    char in[CONN_INBUF];
+    int inLen;
+    Game* game;
+    Team seat;  // NoTeam for a spectator
+
+    pthread_mutex_t outLock;
+    char* out;
+    int outLen;
+    int outCap;
+    bool dead;  // the owner closes it on the next event
+} Conn;
+
+// lock order: bucket, game, connection output
+struct Game {
+    Game* next;
+    char name[GAME_NAMELEN];
+    pthread_mutex_t lock;
+    Conn* players[2];
+    Conn** watchers;
+    int watcherNum;
+    int watcherCap;
+    GameState state;
+};
+
+typedef struct {
+    pthread_mutex_t lock;
+    Game* head;
+} Bucket;
+
+typedef struct {
+    int workerNum;
+    int listenFds[MAXWORKERS];
+    Bucket buckets[GAME_BUCKETS];
+    uint64_t conns;
+    uint64_t games;
+    uint64_t moves;
+} Server;
+
+typedef struct {
+    const char* data;
+    int len;
+} Slice;
+
+// both framings are parsed into this, the slices point into the input buffer
+typedef struct {
+    Slice cmd;
+    Slice game;
+    Slice as;
+    Slice move;
+} Command;
+
+static Server server;
+// set by the signal handler, read by every worker
+static volatile sig_atomic_t stopping = 0;
+
+static void on_stop(int sig) {
+    __atomic_store_n(&stopping, 1, __ATOMIC_RELAXED);
+}
+
+static bool slice_is(Slice s, const char* str) {
+    return s.len == (int) strlen(str) && memcmp(s.data, str, s.len) == 0;
+}
+
+static void conn_kill(Conn* c) {
+    __atomic_store_n(&c->dead, true, __ATOMIC_RELAXED);
+    // the owner sees the hang up and closes the connection
+    shutdown(c->fd, SHUT_RDWR);
+}
+
+// write what the socket takes now and keep the rest for EPOLLOUT, never blocks
+static void conn_send(Conn* c, const char* data, int len) {
+    pthread_mutex_lock(&c->outLock);
+    while (!c->dead && c->outLen == 0 && len > 0) {
+        ssize_t n = send(c->fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN) break;
+            if (errno != EINTR) conn_kill(c);
+            continue;
+        }
+        data += n;
+        len -= n;
+    }
+    if (!c->dead && len > 0) {
+        if (c->outLen + len > CONN_OUTLIMIT) {
+            conn_kill(c);
+        } else {
+            if (c->outLen + len > c->outCap) {
+                char* out = realloc(c->out, (c->outLen + len) * 2);
+                if (out == NULL) {
+                    // the client would miss a part of the stream, it is cut off instead
+                    conn_kill(c);
+                    pthread_mutex_unlock(&c->outLock);
+                    return;
+                }
+                c->out = out;
+                c->outCap = (c->outLen + len) * 2;
+            }
+            memcpy(c->out + c->outLen, data, len);
+            c->outLen += len;
+        }
+    }
+    pthread_mutex_unlock(&c->outLock);
+}
+
+static void conn_flush(Conn* c) {
+    pthread_mutex_lock(&c->outLock);
+    int off = 0;
+    while (!c->dead && off < c->outLen) {
+        ssize_t n = send(c->fd, c->out + off, c->outLen - off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN) break;
+            if (errno != EINTR) conn_kill(c);
+            continue;
+        }
+        off += n;
+    }
+    memmove(c->out, c->out + off, c->outLen - off);
+    c->outLen -= off;
+    pthread_mutex_unlock(&c->outLock);
+}
+
+static const char* seat_name(Team seat) {
+    return seat == White ? "white" : seat == Black ? "black" : "watch";
+}
+
+static const char* result_str(const GameState* game) {
+    if (game->winner == NoTeam) return "1/2-1/2";
+    return game->winner == White ? "1-0" : "0-1";
+}
+
+static void reply_ok(Conn* c) {
+    if (c->json) {
+        conn_send(c, "{\"ok\":true}\n", 12);
+    } else {
+        conn_send(c, "ok\n", 3);
+    }
+}
+
+static void reply_error(Conn* c, const char* msg) {
+    char buf[256];
+    int len;
+    if (c->json) {
+        JsonWriter w;
+        jwriter_init(&w, buf, sizeof(buf) - 1);
+        jwriter_begin_object(&w);
+        jwriter_key(&w, "ok", 2);
+        jwriter_bool(&w, false);
+        jwriter_key(&w, "error", 5);
+        jwriter_str(&w, msg, strlen(msg));
+        jwriter_end_object(&w);
+        if (w.failed) {
+            // the messages are short, a reply without the reason still tells the client it failed
+            fprintf(stderr, "error reply \"%s\" does not fit the json form\n", msg);
+            len = snprintf(buf, sizeof(buf), "{\"ok\":false}\n");
+        } else {
+            len = w.len;
+            buf[len++] = '\n';
+        }
+    } else {
+        len = snprintf(buf, sizeof(buf), "err %s\n", msg);
+    }
+    conn_send(c, buf, len);
+}
+
+// the whole game for a joining client, the game is locked
+static void reply_state(Conn* c, const Game* g) {
+    if (!c->json) {
+        char buf[256], fen[100];
+        Game_toFen(&g->state, fen, sizeof(fen));
+        conn_send(c, buf, snprintf(buf, sizeof(buf), "ok %s %s %d %s\n", g->name, seat_name(c->seat),
+                                   g->state.stepNum, fen));
+        return;
+    }
+    JsonWriter w;
+    jwriter_init_grow(&w, 1024);
+    jwriter_begin_object(&w);
+    jwriter_key(&w, "ok", 2);
+    jwriter_bool(&w, true);
+    jwriter_key(&w, "game", 4);
+    jwriter_str(&w, g->name, strlen(g->name));
+    jwriter_key(&w, "seat", 4);
+    jwriter_str(&w, seat_name(c->seat), strlen(seat_name(c->seat)));
+    jwriter_key(&w, "snapshot", 8);
+    Snapshot_write(&g->state, &w);
+    jwriter_end_object(&w);
+    char* buf = w.failed ? NULL : realloc(w.buf, w.len + 1);
+    if (buf == NULL) {
+        // out of memory, a client that never gets its state is of no use
+        conn_kill(c);
+    } else {
+        w.buf = buf;
+        w.buf[w.len++] = '\n';
+        conn_send(c, w.buf, w.len);
+    }
+    jwriter_free(&w);
+}
+
+// the last move goes to the players and the spectators, each form is built once for all of them
+static void broadcast(Game* g) {
+    const GameState* s = &g->state;
+    char move[5], fen[100], text[320], json[512];
+    Step_tostr(&s->history[s->stepNum - 1], move);
+    Game_toFen(s, fen, sizeof(fen));
+    int textLen = snprintf(text, sizeof(text), "update %s %d %s %s\n", g->name, s->stepNum, move, fen);
+    if (s->isFinished) {
+        textLen += snprintf(text + textLen, sizeof(text) - textLen, "end %s %s\n", g->name, result_str(s));
+    }
+
+    JsonWriter w;
+    jwriter_init(&w, json, sizeof(json) - 1);
+    jwriter_begin_object(&w);
+    jwriter_key(&w, "game", 4);
+    jwriter_str(&w, g->name, strlen(g->name));
+    jwriter_key(&w, "delta", 5);
+    Snapshot_writeDelta(s, s->stepNum - 1, &w);
+    jwriter_end_object(&w);
+    int jsonLen = w.len;
+    if (w.failed) {
+        // the json subscribers miss this update, they can ask for a snap
+        fprintf(stderr, "game %s: update %d does not fit the json form\n", g->name, s->stepNum);
+        jsonLen = 0;
+    } else {
+        json[jsonLen++] = '\n';
+    }
+
+    for (int i = 0; i < 2 + g->watcherNum; i++) {
+        Conn* c = i < 2 ? g->players[i] : g->watchers[i - 2];
+        if (c == NULL) continue;
+        if (__atomic_load_n(&c->json, __ATOMIC_RELAXED)) {
+            if (jsonLen > 0) conn_send(c, json, jsonLen);
+        } else {
+            conn_send(c, text, textLen);
+        }
+    }
+}
+
+static Bucket* game_bucket(const char* name, int len) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < len; i++) h = (h ^ (uint8_t) name[i]) * 16777619u;
+    return &server.buckets[h % GAME_BUCKETS];
+}
+
+// the game is locked
+static void game_detach(Game* g, Conn* c, Team seat) {
+    if (seat != NoTeam) {
+        g->players[seat] = NULL;
+        return;
+    }
+    for (int i = 0; i < g->watcherNum; i++) {
+        if (g->watchers[i] == c) {
+            g->watchers[i] = g->watchers[--g->watcherNum];
+            return;
+        }
+    }
+}
+
+static void game_drop(Conn* c, Game* g, Team seat) {
+    Bucket* b = game_bucket(g->name, strlen(g->name));
+    pthread_mutex_lock(&b->lock);
+    pthread_mutex_lock(&g->lock);
+    game_detach(g, c, seat);
+    // nobody can find a game that is unlinked and empty, it is freed outside the locks
+    bool empty = g->players[White] == NULL && g->players[Black] == NULL && g->watcherNum == 0;
+    if (empty) {
+        Game** p = &b->head;
+        while (*p != g) p = &(*p)->next;
+        *p = g->next;
+    }
+    pthread_mutex_unlock(&g->lock);
+    pthread_mutex_unlock(&b->lock);
+    if (empty) {
+        pthread_mutex_destroy(&g->lock);
+        free(g->watchers);
+        free(g);
+    }
+}
+
+static void game_leave(Conn* c) {
+    if (c->game == NULL) return;
+    game_drop(c, c->game, c->seat);
+    c->game = NULL;
+}
+
+// the new seat is taken before the old one is given up, a refused join keeps the client where it was
+static void game_join(Conn* c, Slice name, Team seat) {
+    Game* old = c->game;
+    Team oldSeat = c->seat;
+    Bucket* b = game_bucket(name.data, name.len);
+    pthread_mutex_lock(&b->lock);
+    Game* g = b->head;
+    while (g != NULL && !slice_is(name, g->name)) g = g->next;
+    if (g == NULL) {
+        g = calloc(1, sizeof(Game));
+        if (g == NULL) {
+            pthread_mutex_unlock(&b->lock);
+            reply_error(c, "out of memory");
+            return;
+        }
+        memcpy(g->name, name.data, name.len);
+        pthread_mutex_init(&g->lock, NULL);
+        InitGame(&g->state);
+        g->next = b->head;
+        b->head = g;
+        __atomic_fetch_add(&server.games, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_lock(&g->lock);
+    // a client joining its own game again only changes its seat
+    bool same = g == old;
+    Conn* holder = seat != NoTeam ? g->players[seat] : NULL;
+    const char* refused = holder != NULL && holder != c ? "seat taken" : NULL;
+    bool grow = seat == NoTeam && !(same && oldSeat == NoTeam) && g->watcherNum == g->watcherCap;
+    if (refused == NULL && grow) {
+        int cap = g->watcherCap * 2 + 4;
+        Conn** watchers = realloc(g->watchers, sizeof(Conn*) * cap);
+        if (watchers == NULL) {
+            refused = "out of memory";
+        } else {
+            g->watchers = watchers;
+            g->watcherCap = cap;
+        }
+    }
+    if (refused == NULL) {
+        if (same) game_detach(g, c, oldSeat);
+        if (seat != NoTeam) {
+            g->players[seat] = c;
+        } else {
+            g->watchers[g->watcherNum++] = c;
+        }
+        c->game = g;
+        c->seat = seat;
+        reply_state(c, g);
+    }
+    // only a game made for this join can be empty after a refusal, it is taken out again
+    bool empty = g->players[White] == NULL && g->players[Black] == NULL && g->watcherNum == 0;
+    if (empty) {
+        Game** p = &b->head;
+        while (*p != g) p = &(*p)->next;
+        *p = g->next;
+    }
+    pthread_mutex_unlock(&g->lock);
+    pthread_mutex_unlock(&b->lock);
+    if (empty) {
+        pthread_mutex_destroy(&g->lock);
+        free(g->watchers);
+        free(g);
+    }
+    if (refused != NULL) {
+        reply_error(c, refused);
+    } else if (old != NULL && !same) {
+        game_drop(c, old, oldSeat);
+    }
+}
+
+static void game_move(Conn* c, Slice move) {
+    Game* g = c->game;
+    if (g == NULL) {
+        reply_error(c, "not in a game");
+        return;
+    }
+    if (c->seat == NoTeam) {
+        reply_error(c, "not a player");
+        return;
+    }
+    if (move.len != 4) {
+        reply_error(c, Response_tostr(ErrParseCmd));
+        return;
+    }
+    char cmd[5];
+    memcpy(cmd, move.data, 4);
+    cmd[4] = '\0';
+
+    pthread_mutex_lock(&g->lock);
+    Response res = c->seat == g->state.turn ? Game_exec(&g->state, cmd) : ErrNotYourTurn;
+    if (res == Success) {
+        broadcast(g);
+        __atomic_fetch_add(&server.moves, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&g->lock);
+    if (res != Success) reply_error(c, Response_tostr(res));
+}
+
+static bool valid_name(Slice name) {
+    if (name.len < 1 || name.len >= GAME_NAMELEN) return false;
+    for (int i = 0; i < name.len; i++) {
+        char ch = name.data[i];
+        bool ok = (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9');
+        if (!ok && ch != '-' && ch != '_' && ch != '.') return false;
+    }
+    return true;
+}
+
+// returns -1 when the client asked to close
+static int exec_command(Conn* c, const Command* cmd) {
+    if (slice_is(cmd->cmd, "move")) {
+        game_move(c, cmd->move);
+    } else if (slice_is(cmd->cmd, "join")) {
+        Team seat = slice_is(cmd->as, "white") ? White : slice_is(cmd->as, "black") ? Black : NoTeam;
+        if (!valid_name(cmd->game)) {
+            reply_error(c, "bad game name");
+        } else if (seat == NoTeam && cmd->as.len != 0 && !slice_is(cmd->as, "watch")) {
+            reply_error(c, "bad seat");
+        } else {
+            game_join(c, cmd->game, seat);
+        }
+    } else if (slice_is(cmd->cmd, "snap")) {
+        if (c->game == NULL) {
+            reply_error(c, "not in a game");
+        } else {
+            pthread_mutex_lock(&c->game->lock);
+            reply_state(c, c->game);
+            pthread_mutex_unlock(&c->game->lock);
+        }
+    } else if (slice_is(cmd->cmd, "leave")) {
+        game_leave(c);
+        reply_ok(c);
+    } else if (slice_is(cmd->cmd, "quit")) {
+        return -1;
+    } else {
+        reply_error(c, "unknown command");
+    }
+    return 0;
+}
+
+// "join <game> [white|black|watch]", "move e2e4", "snap", "leave", "quit"
+static void parse_text(const char* line, int len, Command* cmd) {
+    Slice tok[3] = { { NULL, 0 } };
+    int i = 0;
+    for (int t = 0; t < 3; t++) {
+        while (i < len && line[i] == ' ') i++;
+        int start = i;
+        while (i < len && line[i] != ' ') i++;
+        tok[t] = (Slice){ line + start, i - start };
+    }
+    cmd->cmd = tok[0];
+    if (slice_is(tok[0], "join")) {
+        cmd->game = tok[1];
+        cmd->as = tok[2];
+    } else {
+        cmd->move = tok[1];
+    }
+}
+
+static Slice json_field(const JsonBaseObj* root, const char* key) {
+    const JsonBaseObj* v = minijson_map_get(&root->jsonMap, key, strlen(key));
+    // escapes are never needed here, a view that still has them is refused
+    if (v == NULL || v->type != JStr || v->jsonStr.cap == JSTR_ESCAPED) return (Slice){ NULL, 0 };
+    return (Slice){ v->jsonStr.data, v->jsonStr.len };
+}
+
+// {"cmd":"join","game":"g1","as":"white"}, {"cmd":"move","move":"e2e4"}
+static int parse_json(const char* line, int len, Command* cmd) {
+    JsonDoc* doc = minijson_parse_view(line, len, NULL);
+    if (doc == NULL) return -1;
+    if (doc->root.type == JMap) {
+        cmd->cmd = json_field(&doc->root, "cmd");
+        cmd->game = json_field(&doc->root, "game");
+        cmd->as = json_field(&doc->root, "as");
+        cmd->move = json_field(&doc->root, "move");
+    }
+    // the strings are views into the line, the document is not needed any more
+    minijson_free(doc);
+    return 0;
+}
+
+static int handle_line(Conn* c, const char* line, int len) {
+    if (len > 0 && line[len - 1] == '\r') len--;
+    int i = 0;
+    while (i < len && line[i] == ' ') i++;
+    if (i == len) return 0;
+
+    Command cmd = { 0 };
+    __atomic_store_n(&c->json, line[i] == '{', __ATOMIC_RELAXED);
+    if (c->json) {
+        if (parse_json(line + i, len - i, &cmd) != 0) {
+            reply_error(c, "bad json");
+            return 0;
+        }
+    } else {
+        parse_text(line + i, len - i, &cmd);
+    }
+    return exec_command(c, &cmd);
+}
+
+// edge triggered, so read until the socket is empty
+static int conn_read(Conn* c) {
+    while (true) {
+        ssize_t n = read(c->fd, c->in + c->inLen, CONN_INBUF - c->inLen);
+        if (n == 0) return -1;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN ? 0 : -1;
+        }
+        c->inLen += n;
+
+        // every complete line is handled where it lies, only the partial last one is moved
+        char* start = c->in;
+        char* end = c->in + c->inLen;
+        char* nl;
+        while ((nl = memchr(start, '\n', end - start)) != NULL) {
+            if (handle_line(c, start, nl - start) != 0) return -1;
+            start = nl + 1;
+        }
+        c->inLen = end - start;
+        if (c->inLen == CONN_INBUF) return -1;
+        memmove(c->in, start, c->inLen);
+    }
+}
+
+static void conn_close(int epfd, Conn* c) {
+    // once out of the game no other worker can reach the connection
+    game_leave(c);
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    pthread_mutex_destroy(&c->outLock);
+    free(c->out);
+    free(c);
+}
+
+static void accept_all(int epfd, int lfd) {
+    while (true) {
+        int fd = accept(lfd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return;
+        }
+        int one = 1;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        Conn* c = calloc(1, sizeof(Conn));
+        if (c == NULL) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->seat = NoTeam;
+        pthread_mutex_init(&c->outLock, NULL);
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, .data.ptr = c };
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            conn_close(epfd, c);
+            continue;
+        }
+        __atomic_fetch_add(&server.conns, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void* worker_main(void* arg) {
+    int lfd = server.listenFds[(intptr_t) arg];
+    int epfd = epoll_create1(0);
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev);
+
+    struct epoll_event events[MAXEVENTS];
+    while (!__atomic_load_n(&stopping, __ATOMIC_RELAXED)) {
+        // the timeout only bounds how long a stop request waits
+        int n = epoll_wait(epfd, events, MAXEVENTS, 200);
+        for (int i = 0; i < n; i++) {
+            Conn* c = events[i].data.ptr;
+            if (c == NULL) {
+                accept_all(epfd, lfd);
+                continue;
+            }
+            uint32_t e = events[i].events;
+            if (e & EPOLLOUT) conn_flush(c);
+            bool closed = (e & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) && conn_read(c) != 0;
+            if (closed || __atomic_load_n(&c->dead, __ATOMIC_RELAXED)) conn_close(epfd, c);
+        }
+    }
+    close(epfd);
+    return NULL;
+}
+
+// every worker listens on the port and the kernel spreads the connections over them
+static int listen_socket(const char* addr, int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    struct sockaddr_in sa = { .sin_family = AF_INET, .sin_port = htons(port) };
+    if (inet_pton(AF_INET, addr, &sa.sin_addr) != 1 || bind(fd, (struct sockaddr*) &sa, sizeof(sa)) != 0 ||
+        listen(fd, 1024) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "usage: %s [-a addr] [-p port] [-j threads] [-t table.mctb]...\n", name);
+}
+
+int main(int argc, char** argv) {
+    static Tablebase tables[TB_MAXTABLES];
+    int tableNum = 0;
+    const char* addr = "127.0.0.1";
+    int port = 7000;
+    server.workerNum = sysconf(_SC_NPROCESSORS_ONLN);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "a:p:j:t:")) != -1) {
+        switch (opt) {
+        case 'a':
+            addr = optarg;
+            break;
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 'j':
+            server.workerNum = atoi(optarg);
+            break;
+        case 't':
+            if (tableNum == TB_MAXTABLES || Tablebase_load(&tables[tableNum], optarg) != 0 ||
+                Tablebase_register(&tables[tableNum]) != 0) {
+                fprintf(stderr, "load tablebase %s failed\n", optarg);
+                return 1;
+            }
+            tableNum++;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (server.workerNum < 1) server.workerNum = 1;
+    if (server.workerNum > MAXWORKERS) server.workerNum = MAXWORKERS;
+
+    for (int i = 0; i < GAME_BUCKETS; i++) {
+        pthread_mutex_init(&server.buckets[i].lock, NULL);
+    }
+    for (int i = 0; i < server.workerNum; i++) {
+        server.listenFds[i] = listen_socket(addr, port);
+        if (server.listenFds[i] < 0) {
+            fprintf(stderr, "listen on %s:%d failed: %s\n", addr, port, strerror(errno));
+            return 1;
+        }
+    }
+
+    struct sigaction sa = { .sa_handler = on_stop };
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("listening on %s:%d with %d workers\n", addr, port, server.workerNum);
+    fflush(stdout);
+    pthread_t tids[MAXWORKERS];
+    for (int i = 0; i < server.workerNum; i++) {
+        pthread_create(&tids[i], NULL, worker_main, (void*) (intptr_t) i);
+    }
+    for (int i = 0; i < server.workerNum; i++) {
+        pthread_join(tids[i], NULL);
+        close(server.listenFds[i]);
+    }
+    printf("%llu connections, %llu games, %llu moves\n", (unsigned long long) server.conns,
+           (unsigned long long) server.games, (unsigned long long) server.moves);
+    for (int i = 0; i < tableNum; i++) {
+        Tablebase_free(&tables[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "tablebase.h"
+
+static void usage(const char* name) {
+    fprintf(stderr, "usage: %s [-j threads] [-o dir] material...\n", name);
+    fprintf(stderr, "example: %s -j 8 KQK KRK KPK\n", name);
+}
+
+int main(int argc, char** argv) {
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char* dir = ".";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "j:o:")) != -1) {
+        switch (opt) {
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        case 'o':
+            dir = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (int i = optind; i < argc; i++) {
+        Tablebase tb;
+        struct timespec begin, end;
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        if (Tablebase_generate(&tb, argv[i], threads) != 0) {
+            fprintf(stderr, "%s: generate failed\n", argv[i]);
+            return 1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s.mctb", dir, tb.material);
+        if (Tablebase_save(&tb, path) != 0) {
+            perror(path);
+            return 1;
+        }
+
+        double secs = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+        printf("%s: %llu entries, %d bits each, max dtm %d plies, %.2fs\n", path, (unsigned long long) tb.size,
+               tb.entryBits, tb.maxDtm, secs);
+        Tablebase_free(&tb);
+    }
+    return 0;
+}
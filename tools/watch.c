@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "shmring.h"
+
+static void usage(const char* name) {
+    fprintf(stderr, "usage: %s [-i poll ms] shmname\n", name);
+}
+
+static void show(const ShmPosition* pos) {
+    printf("\nversion %llu, ply %d, %s to move", (unsigned long long) pos->version, pos->ply,
+           pos->turn == White ? "white" : "black");
+    if (pos->isFinished) {
+        printf(", finished, %s", pos->winner == White ? "1-0" : pos->winner == Black ? "0-1" : "1/2-1/2");
+    }
+    printf("\n");
+    for (int y = 7; y >= 0; y--) {
+        printf("%d ", y + 1);
+        for (int x = 0; x < 8; x++) printf(" %c", pos->board[x + 8 * y]);
+        printf("\n");
+    }
+    printf("   a b c d e f g h\nmoves:");
+    for (int i = 0; i < pos->moveNum; i++) printf(" %.4s", pos->moves[i]);
+    printf("\n");
+    fflush(stdout);
+}
+
+// follow a game published by minichess -s, a read is plain loads from the mapping
+int main(int argc, char** argv) {
+    int pollMs = 50;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:")) != -1) {
+        if (opt != 'i') {
+            usage(argv[0]);
+            return 1;
+        }
+        pollMs = atoi(optarg);
+    }
+    if (optind + 1 != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    ShmRing ring;
+    if (ShmRing_open(&ring, argv[optind]) != 0) {
+        fprintf(stderr, "open %s failed, is minichess -s %s running?\n", argv[optind], argv[optind]);
+        return 1;
+    }
+    uint64_t seen = 0;
+    struct timespec pause = { pollMs / 1000, pollMs % 1000 * 1000000L };
+    while (1) {
+        // every version since the last poll that the writer has not overwritten yet
+        uint64_t head = ShmRing_version(&ring);
+        ShmPosition pos;
+        for (uint64_t v = seen; v < head; v++) {
+            if (ShmRing_get(&ring, v, &pos)) show(&pos);
+        }
+        seen = head;
+        nanosleep(&pause, NULL);
+    }
+}